@@ -0,0 +1,84 @@
+#pragma once
+#include "EuroScopePlugIn.h"
+#include "SpatialHash.h"
+#include "SectorGeometry.h"
+#include "Geodesy.h"
+#include <string>
+#include <vector>
+#include <map>
+
+using namespace std;
+using namespace EuroScopePlugIn;
+
+struct Airport {
+    string icao;
+    CPosition pos;
+};
+
+// Every aerodrome in the sector file, indexed by name and bucketed by position, so
+// a target can be matched to the aerodrome it is on with a few cell lookups
+class AirportIndex
+{
+public:
+    AirportIndex(void) : grid(10) {};
+
+    // from the sector file airports; UI thread, once per sector file
+    void Load(const SectorGeometry& geo)
+    {
+        airports.clear();
+        byName.clear();
+        grid.Clear();
+
+        for (int el : geo.OfType(SECTOR_ELEMENT_AIRPORT)) {
+            Airport apt;
+            apt.icao = geo.Name(el);
+            if (apt.icao.empty() || geo.PointCount(el) == 0 || byName.find(apt.icao) != byName.end()) {
+                continue;
+            }
+            apt.pos = geo.Point(el, 0);
+
+            int idx = (int)airports.size();
+            airports.push_back(apt);
+            byName[apt.icao] = idx;
+            grid.Update(idx, apt.pos);
+        }
+
+        loaded = true;
+    };
+
+    bool Loaded() const { return loaded; };
+
+    int Find(const string& icao) const
+    {
+        auto a = byName.find(icao);
+        return a == byName.end() ? -1 : a->second;
+    };
+
+    // closest aerodrome within maxNM of pos, -1 if none
+    int Nearest(CPosition pos, double maxNM) const
+    {
+        near.clear();
+        grid.Query(pos, maxNM, near);
+
+        int best = -1;
+        double bestDist = maxNM;
+        for (int idx : near) {
+            double d = Geodesy::DistanceNM(pos, airports[idx].pos);
+            if (d <= bestDist) {
+                bestDist = d;
+                best = idx;
+            }
+        }
+        return best;
+    };
+
+    const Airport& Get(int idx) const { return airports[idx]; };
+    int Count() const { return (int)airports.size(); };
+
+protected:
+    vector<Airport> airports;
+    map<string, int> byName;
+    SpatialHash<int> grid;
+    mutable vector<int> near;
+    bool loaded = false;
+};
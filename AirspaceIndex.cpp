@@ -0,0 +1,237 @@
+#include "pch.h"
+#include "AirspaceIndex.h"
+#include <algorithm>
+#include <sstream>
+
+void AirspaceIndex::Load(const SectorGeometry& geo)
+{
+	volumes.clear();
+	edges.clear();
+	cells.clear();
+
+	for (int el : geo.OfType(SECTOR_ELEMENT_AIRSPACE)) {
+		if (geo.PointCount(el) < 3) {
+			continue;
+		}
+
+		// sectors may come through as "name:floor:ceiling" like in the ese; without
+		// the limits the volume is treated as surface to unlimited
+		AirspaceVolume v;
+		string token;
+		istringstream name(geo.Name(el));
+		for (int i = 0; getline(name, token, ':'); i++) {
+			try {
+				if (i == 0) { v.name = token; }
+				if (i == 1) { v.floor = stoi(token); }
+				if (i == 2) { v.ceiling = stoi(token); }
+			}
+			catch (...) {}
+		}
+		if (v.name.empty()) {
+			continue;
+		}
+
+		v.minLat = v.maxLat = geo.Point(el, 0).m_Latitude;
+		v.minLon = v.maxLon = geo.Point(el, 0).m_Longitude;
+		for (int i = 0; i < geo.PointCount(el); i++) {
+			CPosition p = geo.Point(el, i);
+			v.poly.push_back(p);
+			v.minLat = min(v.minLat, p.m_Latitude);
+			v.maxLat = max(v.maxLat, p.m_Latitude);
+			v.minLon = min(v.minLon, p.m_Longitude);
+			v.maxLon = max(v.maxLon, p.m_Longitude);
+		}
+
+		int vi = (int)volumes.size();
+		volumes.push_back(v);
+
+		// closed polygon, every edge goes in each cell its bounding box touches
+		for (size_t i = 0; i < v.poly.size(); i++) {
+			const CPosition& a = v.poly[i];
+			const CPosition& b = v.poly[(i + 1) % v.poly.size()];
+
+			int ei = (int)edges.size();
+			edges.push_back({ vi, a.m_Latitude, a.m_Longitude, b.m_Latitude, b.m_Longitude });
+
+			int r0 = (int)floor(min(a.m_Latitude, b.m_Latitude) / AIRSPACE_CELL_DEG);
+			int r1 = (int)floor(max(a.m_Latitude, b.m_Latitude) / AIRSPACE_CELL_DEG);
+			int c0 = (int)floor(min(a.m_Longitude, b.m_Longitude) / AIRSPACE_CELL_DEG);
+			int c1 = (int)floor(max(a.m_Longitude, b.m_Longitude) / AIRSPACE_CELL_DEG);
+			for (int r = r0; r <= r1; r++) {
+				for (int c = c0; c <= c1; c++) {
+					cells[Pack(r, c)].push_back(ei);
+				}
+			}
+		}
+	}
+
+	edgeStamp.assign(edges.size(), 0);
+	loaded = true;
+
+	Select(set<string>(selectedNames));
+}
+
+void AirspaceIndex::Select(const set<string>& names)
+{
+	selectedNames = names;
+	selected.assign(volumes.size(), false);
+	selectedCount = 0;
+
+	for (size_t i = 0; i < volumes.size(); i++) {
+		if (selectedNames.find(volumes[i].name) != selectedNames.end()) {
+			selected[i] = true;
+			selectedCount++;
+		}
+	}
+}
+
+void AirspaceIndex::Predict(CPosition pos, double trk, int gs, int alt, int vs, int& entrySec, int& exitSec) const
+{
+	entrySec = -1;
+	exitSec = -1;
+	if (selectedCount == 0) {
+		return;
+	}
+
+	// straight line over the look ahead; crossing times are a fraction of it, which
+	// works the same in lat/lon as on a flat projection
+	const double span = AIRSPACE_LOOKAHEAD;
+	CPosition end = Geodesy::DestinationPoint(pos, trk, gs * span / 3600.0);
+	double dLat = end.m_Latitude - pos.m_Latitude;
+	double dLon = end.m_Longitude - pos.m_Longitude;
+
+	crossings.clear();
+	if (++stamp == 0) {
+		fill(edgeStamp.begin(), edgeStamp.end(), 0);
+		stamp = 1;
+	}
+
+	int r0 = (int)floor(min(pos.m_Latitude, end.m_Latitude) / AIRSPACE_CELL_DEG);
+	int r1 = (int)floor(max(pos.m_Latitude, end.m_Latitude) / AIRSPACE_CELL_DEG);
+	int c0 = (int)floor(min(pos.m_Longitude, end.m_Longitude) / AIRSPACE_CELL_DEG);
+	int c1 = (int)floor(max(pos.m_Longitude, end.m_Longitude) / AIRSPACE_CELL_DEG);
+
+	for (int r = r0; r <= r1; r++) {
+		for (int c = c0; c <= c1; c++) {
+			auto cell = cells.find(Pack(r, c));
+			if (cell == cells.end()) {
+				continue;
+			}
+
+			for (int ei : cell->second) {
+				const AirspaceEdge& e = edges[ei];
+				if (edgeStamp[ei] == stamp || !selected[e.volume]) {
+					continue;
+				}
+				edgeStamp[ei] = stamp;
+
+				// track segment against the edge
+				double eLat = e.lat1 - e.lat0;
+				double eLon = e.lon1 - e.lon0;
+				double den = dLon * eLat - dLat * eLon;
+				if (den == 0) {
+					continue;
+				}
+				double t = ((e.lon0 - pos.m_Longitude) * eLat - (e.lat0 - pos.m_Latitude) * eLon) / den;
+				double u = ((e.lon0 - pos.m_Longitude) * dLat - (e.lat0 - pos.m_Latitude) * dLon) / den;
+				if (t > 0 && t <= 1 && u >= 0 && u < 1) {
+					crossings.push_back(make_pair(e.volume, t * span));
+				}
+			}
+		}
+	}
+	sort(crossings.begin(), crossings.end());
+
+	// per volume: time inside laterally, cut down to the time inside its limits
+	spans.clear();
+	size_t ci = 0;
+	for (int vi = 0; vi < (int)volumes.size(); vi++) {
+		if (!selected[vi]) {
+			continue;
+		}
+		const AirspaceVolume& v = volumes[vi];
+
+		size_t first = ci;
+		while (ci < crossings.size() && crossings[ci].first == vi) {
+			ci++;
+		}
+		bool in = pos.m_Latitude >= v.minLat && pos.m_Latitude <= v.maxLat
+			&& pos.m_Longitude >= v.minLon && pos.m_Longitude <= v.maxLon && Inside(v, pos.m_Latitude, pos.m_Longitude);
+		if (first == ci && !in) {
+			continue;
+		}
+
+		double vLo = 0;
+		double vHi = span;
+		if (vs == 0) {
+			if (alt < v.floor || alt > v.ceiling) {
+				continue;
+			}
+		}
+		else {
+			double tf = (v.floor - alt) * 60.0 / vs;
+			double tc = (v.ceiling - alt) * 60.0 / vs;
+			vLo = max(vLo, min(tf, tc));
+			vHi = min(vHi, max(tf, tc));
+			if (vLo > vHi) {
+				continue;
+			}
+		}
+
+		double start = in ? 0 : -1;
+		for (size_t i = first; i <= ci; i++) {
+			double t = i < ci ? crossings[i].second : span;
+			if (start >= 0) {
+				double lo = max(start, vLo);
+				double hi = min(t, vHi);
+				if (lo <= hi) {
+					spans.push_back(make_pair(lo, hi));
+				}
+				start = -1;
+			}
+			else {
+				start = t;
+			}
+		}
+	}
+
+	// the selected volumes together, so moving between two of them is not an exit
+	sort(spans.begin(), spans.end());
+	double curLo = -1;
+	double curHi = -1;
+	for (size_t i = 0; i <= spans.size(); i++) {
+		if (i < spans.size() && curLo >= 0 && spans[i].first <= curHi + AIRSPACE_JOIN_SEC) {
+			curHi = max(curHi, spans[i].second);
+			continue;
+		}
+
+		if (curLo >= 0) {
+			if (curLo <= 0 && curHi < span) {
+				exitSec = (int)curHi;
+			}
+			if (curLo > 0 && entrySec < 0) {
+				entrySec = (int)curLo;
+			}
+		}
+
+		if (i < spans.size()) {
+			curLo = spans[i].first;
+			curHi = spans[i].second;
+		}
+	}
+}
+
+// even-odd ray cast
+bool AirspaceIndex::Inside(const AirspaceVolume& v, double lat, double lon)
+{
+	bool in = false;
+	for (size_t i = 0, j = v.poly.size() - 1; i < v.poly.size(); j = i++) {
+		const CPosition& a = v.poly[i];
+		const CPosition& b = v.poly[j];
+		if ((a.m_Latitude > lat) != (b.m_Latitude > lat)
+			&& lon < (b.m_Longitude - a.m_Longitude) * (lat - a.m_Latitude) / (b.m_Latitude - a.m_Latitude) + a.m_Longitude) {
+			in = !in;
+		}
+	}
+	return in;
+}
@@ -0,0 +1,78 @@
+#pragma once
+#include "EuroScopePlugIn.h"
+#include "SectorGeometry.h"
+#include "Geodesy.h"
+#include <string>
+#include <vector>
+#include <set>
+#include <unordered_map>
+
+using namespace std;
+using namespace EuroScopePlugIn;
+
+// edge grid cell size, degrees
+const double AIRSPACE_CELL_DEG = 0.5;
+
+// how far along its track a target is checked for entry and exit, seconds
+const int AIRSPACE_LOOKAHEAD = 1200;
+
+// gaps shorter than this between two selected volumes count as the same airspace
+const double AIRSPACE_JOIN_SEC = 5;
+
+struct AirspaceVolume {
+    string name;
+    vector<CPosition> poly;
+    int floor = 0; // ft
+    int ceiling = 99999;
+    double minLat = 0, maxLat = 0, minLon = 0, maxLon = 0;
+};
+
+struct AirspaceEdge {
+    int volume;
+    double lat0, lon0, lat1, lon1;
+};
+
+// Lateral polygons and altitude limits of the sectors in the sector file, with every
+// polygon edge bucketed on a lat/lon grid. A target's track over the look ahead is
+// only tested against the edges in the cells it crosses, and the crossings plus the
+// climb or descent through the limits give the times it enters and leaves the
+// selected volumes.
+class AirspaceIndex
+{
+public:
+    // UI thread, once per sector file
+    void Load(const SectorGeometry& geo);
+
+    bool Loaded() const { return loaded; };
+    int Count() const { return (int)volumes.size(); };
+    const AirspaceVolume& Get(int idx) const { return volumes[idx]; };
+
+    // the volumes treated as our airspace; unknown names are kept so a selection
+    // saved with another sector file comes back when that file does
+    void Select(const set<string>& names);
+    const set<string>& Selected() const { return selectedNames; };
+    bool HasSelection() const { return selectedCount > 0; };
+
+    // seconds until the target enters and leaves the selected airspace, -1 when that
+    // is not within the look ahead
+    void Predict(CPosition pos, double trk, int gs, int alt, int vs, int& entrySec, int& exitSec) const;
+
+protected:
+    static bool Inside(const AirspaceVolume& v, double lat, double lon);
+    static long long Pack(int row, int col) { return ((long long)row << 32) | (unsigned int)col; };
+
+    vector<AirspaceVolume> volumes;
+    vector<AirspaceEdge> edges;
+    unordered_map<long long, vector<int>> cells;
+
+    set<string> selectedNames;
+    vector<bool> selected; // by volume
+    int selectedCount = 0;
+    bool loaded = false;
+
+    // scratch for Predict, UI thread only
+    mutable vector<unsigned int> edgeStamp;
+    mutable unsigned int stamp = 0;
+    mutable vector<pair<int, double>> crossings;
+    mutable vector<pair<double, double>> spans;
+};
@@ -0,0 +1,10 @@
+#include "pch.h"
+#include "CPATool.h"
+
+CPATool::CPATool()
+{
+}
+
+CPATool::~CPATool()
+{
+}
@@ -0,0 +1,128 @@
+#pragma once
+#include "EuroScopePlugIn.h"
+#include "Geodesy.h"
+#include "TargetStore.h"
+#include "FrameArena.h"
+#include <string>
+#include <vector>
+#include <ctime>
+
+using namespace std;
+using namespace EuroScopePlugIn;
+
+// closest point of approach of a pair of targets, as of the time it was calculated
+struct CPAResult {
+    double tcpa = 0; // minutes from calcTime
+    double dcpa = 0; // NM
+    CPosition mid; // half way between the two aircraft at the cpa
+    clock_t calcTime = 0;
+};
+
+// "m:ss d.d" time to go and distance at the cpa
+typedef InlineString<24> CPALabel;
+
+class CPATool :
+    public CRadarScreen
+{
+public:
+    CPATool(void);
+    ~CPATool(void);
+
+    // pairs are stored once, under the callsigns in order
+    static pair<string, string> PairKey(const string& a, const string& b)
+    {
+        return a < b ? make_pair(a, b) : make_pair(b, a);
+    };
+
+    // analytical cpa for two straight line tracks from the filtered state. Positions are put
+    // on a flat plane around the first aircraft, which is fine at the ranges the pairs are searched in
+    static CPAResult CalcCPA(const TargetData& a, const TargetData& b)
+    {
+        double midLat = Geodesy::ToRad((a.fpos.m_Latitude + b.fpos.m_Latitude) / 2);
+
+        // relative position (NM) and velocity (NM/min) of b from a
+        double dx = (b.fpos.m_Longitude - a.fpos.m_Longitude) * 60.0 * cos(midLat);
+        double dy = (b.fpos.m_Latitude - a.fpos.m_Latitude) * 60.0;
+
+        double vax = a.gs / 60.0 * sin(Geodesy::ToRad(a.trk));
+        double vay = a.gs / 60.0 * cos(Geodesy::ToRad(a.trk));
+        double vbx = b.gs / 60.0 * sin(Geodesy::ToRad(b.trk));
+        double vby = b.gs / 60.0 * cos(Geodesy::ToRad(b.trk));
+
+        double vx = vbx - vax;
+        double vy = vby - vay;
+        double v2 = vx * vx + vy * vy;
+
+        CPAResult res;
+        res.tcpa = 0;
+        if (v2 > 1e-9) {
+            res.tcpa = -(dx * vx + dy * vy) / v2;
+        }
+        if (res.tcpa < 0) {
+            res.tcpa = 0; // diverging, closest is now
+        }
+
+        double cx = dx + vx * res.tcpa;
+        double cy = dy + vy * res.tcpa;
+        res.dcpa = sqrt(cx * cx + cy * cy);
+
+        CPosition pa = Geodesy::DestinationPoint(a.fpos, a.trk, a.gs * res.tcpa / 60.0);
+        CPosition pb = Geodesy::DestinationPoint(b.fpos, b.trk, b.gs * res.tcpa / 60.0);
+        res.mid.m_Latitude = (pa.m_Latitude + pb.m_Latitude) / 2;
+        res.mid.m_Longitude = (pa.m_Longitude + pb.m_Longitude) / 2;
+        res.calcTime = clock();
+
+        return res;
+    };
+
+    // small x at each cpa point with the time to go and the distance next to it.
+    // red when the pair will be closer than the separation (halo) radius
+    static void DrawCPAs(HDC hdc, FrameVector<POINT>& pts, FrameVector<CPALabel>& labels, FrameVector<bool>& loss)
+    {
+        if (pts.empty()) {
+            return;
+        }
+
+        CDC dc;
+        dc.Attach(hdc);
+
+        CFont font;
+        LOGFONT lgfont;
+
+        memset(&lgfont, 0, sizeof(LOGFONT));
+        lgfont.lfWeight = 500;
+        strcpy_s(lgfont.lfFaceName, _T("EuroScope"));
+        lgfont.lfHeight = 12;
+        font.CreateFontIndirect(&lgfont);
+        dc.SelectObject(font);
+
+        HPEN amberPen = CreatePen(PS_SOLID, 1, RGB(202, 205, 169));
+        HPEN redPen = CreatePen(PS_SOLID, 1, RGB(209, 39, 27));
+
+        // two passes so each colour only selects its pen once
+        for (int pass = 0; pass < 2; pass++) {
+            bool red = pass == 1;
+            dc.SelectObject(red ? redPen : amberPen);
+            dc.SetTextColor(red ? RGB(209, 39, 27) : RGB(202, 205, 169));
+
+            for (size_t i = 0; i < pts.size(); i++) {
+                if (loss[i] != red) {
+                    continue;
+                }
+
+                POINT p = pts[i];
+                dc.MoveTo(p.x - 3, p.y - 3);
+                dc.LineTo(p.x + 4, p.y + 4);
+                dc.MoveTo(p.x + 3, p.y - 3);
+                dc.LineTo(p.x - 4, p.y + 4);
+
+                dc.TextOut(p.x + 6, p.y - 6, labels[i].c_str(), (int)labels[i].size());
+            }
+        }
+
+        DeleteObject(amberPen);
+        DeleteObject(redPen);
+        DeleteObject(font);
+        dc.Detach();
+    };
+};
@@ -14,22 +14,43 @@
 #include "TopMenu.h"
 #include "SituPlugin.h"
 #include "GndRadar.h"
+#include "PTLTool.h"
+#include "RBLTool.h"
+#include "RingsGrid.h"
+#include "CPATool.h"
+#include "ClusterTool.h"
+#include "TargetFilter.h"
+#include "FrameArena.h"
+#include "tagRender.h"
 #include <chrono>
+#include <algorithm>
+#include <sstream>
+#include <set>
 
 using namespace Gdiplus;
 
+// every open screen, so targets the plugin drops are cleaned up on all of them; UI thread only
+static set<CSiTRadar*> openScreens;
 
 CSiTRadar::CSiTRadar()
 {
+	openScreens.insert(this);
 	halfSec = clock();
+	targetGrid.SetCellSize(cpaRadius);
+	CompileAltFilter();
 }
 
 CSiTRadar::~CSiTRadar()
 {
+	openScreens.erase(this);
+	GndRadar::FreeStyle(gndStyle);
+	ScheduleXtrapFrame(0);
 }
 
 void CSiTRadar::OnRefresh(HDC hdc, int phase)
 {
+	// hand back anything the background tasks finished since the last refresh or tick
+	static_cast<SituPlugin*>(GetPlugIn())->pool.DrainCompletions();
 
 	// get cursor position and screen info
 	POINT p;
@@ -55,7 +76,61 @@ void CSiTRadar::OnRefresh(HDC hdc, int phase)
 
 	int pixnm = PixelsPerNM();
 
+	// the plugin video map goes under everything else in the back bitmap, at the level of detail
+	// for the zoom, and like the rings is only converted to pixels again when the viewport moves
+	if (phase == REFRESH_PHASE_BACK_BITMAP && mapLayers != 0) {
+		shared_ptr<const VideoMapData> vmap = static_cast<SituPlugin*>(GetPlugIn())->videoMap;
+		if (vmap) {
+			if (VideoMap::CacheStale(this, videoMapCache, vmap.get(), mapLayers)) {
+				VideoMap::BuildCache(this, *vmap, mapLayers, videoMapCache);
+			}
+			VideoMap::DrawLayers(dc, videoMapCache);
+		}
+	}
+
+	// range rings and grid go in the back bitmap, which ES caches between frames. The geometry
+	// is only rebuilt when the viewport moved since it was last generated
+	if (phase == REFRESH_PHASE_BACK_BITMAP && (ringsOn || gridOn)) {
+		if (RingsGrid::ViewportChanged(this, ringsGridCache)) {
+			ringsGridCache.pts.clear();
+			ringsGridCache.counts.clear();
+			GetDisplayArea(&ringsGridCache.ll, &ringsGridCache.ur);
+			ringsGridCache.area = radarea;
+
+			if (!ringCentreSet) {
+				ringCentre.m_Latitude = (ringsGridCache.ll.m_Latitude + ringsGridCache.ur.m_Latitude) / 2;
+				ringCentre.m_Longitude = (ringsGridCache.ll.m_Longitude + ringsGridCache.ur.m_Longitude) / 2;
+				ringCentreSet = TRUE;
+			}
+
+			if (ringsOn) {
+				RingsGrid::BuildRings(this, ringCentre, ringSpacing, ringsGridCache);
+			}
+			if (gridOn) {
+				RingsGrid::BuildGrid(this, ringsGridCache);
+			}
+			ringsGridCache.valid = TRUE;
+		}
+
+		RingsGrid::DrawLayer(dc, ringsGridCache);
+	}
+
 	if (phase == REFRESH_PHASE_AFTER_TAGS) {
+		frameBudget.Begin();
+#ifdef _DEBUG
+		FrameAllocCounter::Begin();
+#endif
+
+		// the video map finished building in the background since the back bitmap was drawn
+		if (mapLayers != 0 && static_cast<SituPlugin*>(GetPlugIn())->videoMap.get() != videoMapCache.source) {
+			RefreshMapContent();
+		}
+
+		// while placing an RBL the whole radar area is a screen object, so empty map clicks
+		// and cursor moves come back to the plugin. Added first so targets and the menu are on top
+		if (rbltool || ringCentrePick) {
+			AddScreenObject(SCREEN_BACKGROUND, "", radarea, FALSE, "");
+		}
 
 		// Draw the mouse halo before menu, so it goes behind it
 		if (mousehalo == TRUE) {
@@ -63,30 +138,226 @@ void CSiTRadar::OnRefresh(HDC hdc, int phase)
 			RequestRefresh();
 		}
 
-		// add orange PPS to aircrafts with VFR Flight Plans that have correlated targets
-		// iterate over radar targets
+		// everything the frame collects lives in the frame arena, given back at the end of OnRefresh
+
+		// PTL start and end points collected in the target loop, drawn in one batch after it
+		FrameVector<POINT> ptlPoints;
+
+		// callsigns in conflict alert, worked out off the UI thread and only read here
+		const vector<string>& stcaAlerts = static_cast<SituPlugin*>(GetPlugIn())->stca.Alerts();
+
+		// the store itself rather than a snapshot: drawing is on the UI thread with the store's
+		// writers, so nothing needs copying. Snapshots are for the background tasks, taken on the timer
+		TargetStore& store = static_cast<SituPlugin*>(GetPlugIn())->targets;
+		store.Flush();
+		const TargetMap& targets = store.Targets();
+		static const TargetData noData;
+
+		for (const string& callsign : ptlDirty) {
+			auto td = targets.find(callsign);
+			if (td != targets.end()) {
+				ptlEnds[callsign] = PTLTool::CalcPTLEnd(td->second.pos, td->second.trk, td->second.gs, ptlLen);
+			}
+		}
+		ptlDirty.clear();
+
+		// smooth motion: the targets on the display are moved on from their filtered state
+		// to now in one pass over the filter, then looked up by slot in the loop below
+		FrameVector<int> xtrapSlots;
+		FrameVector<CPosition> xtrapPos;
+		FrameVector<int> xtrapAt;
+		int xtrapMaxGs = 0;
+		if (xtrapOn) {
+			const TrackFilter& filter = store.Filter();
+			xtrapAt.assign(filter.Slots(), -1);
+			xtrapSlots.reserve(targets.size());
+
+			CPosition ll, ur;
+			GetDisplayArea(&ll, &ur);
+			for (auto& td : targets) {
+				const CPosition& pos = td.second.pos;
+				if (td.second.slot < 0 || td.second.slot >= filter.Slots()
+					|| pos.m_Latitude < ll.m_Latitude || pos.m_Latitude > ur.m_Latitude
+					|| pos.m_Longitude < ll.m_Longitude || pos.m_Longitude > ur.m_Longitude) {
+					continue;
+				}
+				xtrapAt[td.second.slot] = (int)xtrapSlots.size();
+				xtrapSlots.push_back(td.second.slot);
+				xtrapMaxGs = max(xtrapMaxGs, td.second.gs);
+			}
+
+			xtrapPos.resize(xtrapSlots.size());
+			filter.Extrapolate(xtrapSlots.data(), xtrapSlots.size(), GetTickCount64() / 1000.0, xtrapPos.data());
+		}
+
+		// data blocks and the CJS text share one font, and the blocks one leader pen, for the frame
+		CFont tagFont;
+		HPEN tagPen = NULL;
+		string myId;
+		{
+			LOGFONT lgfont;
+
+			memset(&lgfont, 0, sizeof(LOGFONT));
+			lgfont.lfWeight = 500;
+			strcpy_s(lgfont.lfFaceName, _T("EuroScope"));
+			lgfont.lfHeight = 12;
+			tagFont.CreateFontIndirect(&lgfont);
+		}
+		if (tagsOn) {
+			tagPen = CreatePen(PS_SOLID, 1, RGB(202, 205, 169));
+		}
+		if (GetPlugIn()->ControllerMyself().IsValid()) {
+			myId = GetPlugIn()->ControllerMyself().GetPositionId();
+		}
+
+		struct TagDraw {
+			const string* callsign;
+			const TagLayout* layout;
+			POINT p;
+			bool inConflict;
+		};
+		FrameVector<TagDraw> tagsToDraw;
+		tagPlacer.BeginFrame();
+
+		// history dots come from the store's trail buffers and are drawn together after the loop
+		const HistoryTrails& trails = store.Trails();
+		FrameVector<POINT> trailDots;
+
+		// over the frame budget, the middle of the radar area is where halos are still drawn
+		RECT focus = radarea;
+		InflateRect(&focus, -(radarea.right - radarea.left) / 4, -(radarea.bottom - radarea.top) / 4);
+
+		// ground mode: targets slow and low at the selected aerodrome get ground tags instead
+		SituPlugin* plugin = static_cast<SituPlugin*>(GetPlugIn());
+		int gndIdx = gndMode ? plugin->airports.Find(gndAirport) : -1;
+
+		struct GndDraw {
+			const TagLayout* layout;
+			POINT p;
+			int sts;
+		};
+		FrameVector<GndDraw> gndToDraw;
+		map<int, int, less<int>, FrameAllocator<pair<const int, int>>> rwyOccupants; // runway segment, ground targets on it
+		if (gndIdx >= 0) {
+			GndRadar::MakeStyle(gndStyle);
+			gndToDraw.reserve(200);
+		}
+
+		// medium term conflicts, kept up to date by the plugin on the timer
+		const map<string, MTCDConflict>& mtcdConflicts = static_cast<SituPlugin*>(GetPlugIn())->mtcdConflicts;
+
+		// draw order: each target gets a priority class and they are drawn lowest first, so
+		// emergencies and our own traffic are never overdrawn by a neighbour. The altitude
+		// filter's inputs are gathered on the same pass, one entry per target in add order
+		drawOrder.Clear();
+		FrameVector<int> filtAlt;
+		FrameVector<uint8_t> filtFlags;
+
+		// quick look: everything the chosen positions track, by track filter slot
+		FrameVector<uint64_t> quickLookSlots;
+		plugin->targets.Owners().Gather(quickLook, quickLookSlots);
 
 		for (CRadarTarget radarTarget = GetPlugIn()->RadarTargetSelectFirst(); radarTarget.IsValid();
 			radarTarget = GetPlugIn()->RadarTargetSelectNext(radarTarget))
 		{
-			// altitude filtering 
-			if (altFilterOn && radarTarget.GetPosition().GetPressureAltitude() < altFilterLow * 100) {
-				continue;
+			CFlightPlan fp = radarTarget.GetCorrelatedFlightPlan();
+			int prio = PRIO_OTHER;
+			uint8_t flags = 0;
+			if (!strcmp(radarTarget.GetPosition().GetSquawk(), "7600") || !strcmp(radarTarget.GetPosition().GetSquawk(), "7700")) {
+				prio = PRIO_EMERGENCY;
+				flags |= TF_EMERGENCY;
+			}
+			else if (fp.GetTrackingControllerIsMe() && strcmp(fp.GetHandoffTargetControllerId(), "") == 0) {
+				prio = PRIO_OWNED;
+			}
+			else if (fp.GetTrackingControllerIsMe() || (!myId.empty() && myId == fp.GetHandoffTargetControllerId())) {
+				prio = PRIO_HANDOFF;
+			}
+			else if (hashalo.find(radarTarget.GetCallsign()) != hashalo.end()) {
+				prio = PRIO_HALOED;
 			}
+			drawOrder.Add(radarTarget, prio);
 
-			if (altFilterOn && altFilterHigh > 0 && radarTarget.GetPosition().GetPressureAltitude() > altFilterHigh * 100) {
-				continue;
+			if (fp.GetTrackingControllerIsMe()) { flags |= TF_OWNED; }
+			if (hashalo.find(radarTarget.GetCallsign()) != hashalo.end()) { flags |= TF_HALOED; }
+
+			auto tdi = targets.find(radarTarget.GetCallsign());
+			const TargetData& td = tdi != targets.end() ? tdi->second : noData;
+			if (td.planType == 'V') { flags |= TF_VFR; }
+			if (gndIdx >= 0 && td.airport == gndIdx && td.gs <= gndMaxGs && td.alt <= gndMaxAlt) { flags |= TF_GROUND; }
+			if (OwnerIndex::Has(quickLookSlots, td.slot)) { flags |= TF_QUICKLOOK; }
+
+			filtAlt.push_back(radarTarget.GetPosition().GetPressureAltitude());
+			filtFlags.push_back(flags);
+		}
+
+		// altitude filter, a bit per target
+		FrameVector<uint64_t> visible;
+		altFilter.Run(filtAlt.data(), filtFlags.data(), filtAlt.size(), visible);
+
+		// wide ranges: targets are drawn as counts per screen cell, or a heatmap, rather than one
+		// at a time. Only the targets always drawn in full get their own PPS, and they and anything
+		// the altitude filter hides are left out of the counts
+		bool clustered = clusterOn && RadRange() > clusterRange;
+		if (clustered) {
+			clusterGrid.BeginFrame();
+			for (const DrawItem& item : drawOrder.Items()) {
+				clusterGrid.Set(item.target.GetCallsign(), item.target.GetPosition().GetPosition(),
+					item.prio < PRIO_HANDOFF && TargetFilter::Visible(visible, item.index));
+			}
+			clusterGrid.Evict();
+
+			const vector<Cluster>& clusters = ClusterTool::Aggregate(this, clusterGrid);
+			if (densityOn) {
+				ClusterTool::DrawDensity(dc, clusters);
 			}
+			else {
+				ClusterTool::DrawClusters(dc, clusters);
+			}
+		}
+
+		// add orange PPS to aircrafts with VFR Flight Plans that have correlated targets
+		// iterate over radar targets
+
+		for (const DrawItem& item : drawOrder.Sorted())
+		{
+			CRadarTarget radarTarget = item.target;
+
+			// aircraft equipment and plan type, classified once in the plugin's target store
+			auto tdi = targets.find(radarTarget.GetCallsign());
+			const TargetData& td = tdi != targets.end() ? tdi->second : noData;
+			bool isRVSM = td.isRVSM;
+			bool isADSB = td.isADSB;
 
-			// aircraft equipment parsing
-			string icaoACData = radarTarget.GetCorrelatedFlightPlan().GetFlightPlanData().GetAircraftInfo();
-			regex icaoRVSM("(.*)\\/(.*)\\-(.*)[W](.*)\\/(.*)", regex::icase);
-			bool isRVSM = regex_search(icaoACData, icaoRVSM);
-			regex icaoADSB("(.*)\\/(.*)\\-(.*)\\/(.*)(E|L|B1|B2|U1|U2|V1|V2)(.*)");
-			bool isADSB = regex_search(icaoACData, icaoADSB);
+			bool onGnd = gndIdx >= 0 && td.airport == gndIdx && td.gs <= gndMaxGs && td.alt <= gndMaxAlt;
+
+			// altitude filtering, ground targets are shown whatever the filter
+			if (!TargetFilter::Visible(visible, item.index)) {
+				continue;
+			}
 
 			// get the target's position on the screen and add it as a screen object
 			POINT p = ConvertCoordFromPositionToPixel(radarTarget.GetPosition().GetPosition());
+			POINT pReported = p;
+			if (xtrapOn && td.slot >= 0 && td.slot < (int)xtrapAt.size() && xtrapAt[td.slot] >= 0) {
+				p = ConvertCoordFromPositionToPixel(xtrapPos[xtrapAt[td.slot]]);
+			}
+
+			// emergencies and our own targets, handoffs included, are drawn in full however far over budget the frame is
+			bool keepAll = item.prio >= PRIO_HANDOFF;
+			bool onRadarArea = PtInRect(&radarea, p) != FALSE;
+			if (clustered && !keepAll) {
+				continue;
+			}
+
+			if (trailLen > 0) {
+				const TrailBuffer* trail = trails.Find(radarTarget.GetCallsign());
+				int len = !keepAll && frameBudget.Drops(DEGRADE_TRAILS) ? min(trailLen, DEGRADE_TRAIL_LEN) : trailLen;
+				int n = trail != nullptr ? min(len, (int)trail->count) : 0;
+				for (int i = 0; i < n; i++) {
+					trailDots.push_back(ConvertCoordFromPositionToPixel(HistoryTrails::Point(*trail, i)));
+				}
+			}
 			RECT prect;
 			prect.left = p.x - 5;
 			prect.top = p.y - 5;
@@ -94,46 +365,45 @@ void CSiTRadar::OnRefresh(HDC hdc, int phase)
 			prect.bottom = p.y + 5;
 			AddScreenObject(AIRCRAFT_SYMBOL, radarTarget.GetCallsign(), prect, FALSE, "");
 
-			// Handoff warning system: if the plane is within 2 minutes of exiting your airspace, CJS will blink
+			bool inConflict = binary_search(stcaAlerts.begin(), stcaAlerts.end(), radarTarget.GetCallsign());
 
+			// Handoff warning system: if the plane is within 2 minutes of exiting your airspace, CJS will blink.
+			// with sectors picked from the CJS menu, the plugin's own prediction is used with the chosen lead
+			// time, and aircraft tracked by others blink before they enter
+
+			bool blinking = FALSE;
 			if (radarTarget.GetCorrelatedFlightPlan().GetTrackingControllerIsMe()) {
-				if (radarTarget.GetCorrelatedFlightPlan().GetSectorExitMinutes() <= 2 
-					&& radarTarget.GetCorrelatedFlightPlan().GetSectorExitMinutes() >= 0) {
-					// blink the CJS
-					string callsign = radarTarget.GetCallsign();
-					isBlinking[callsign] = TRUE;
-				}
+				// blink the CJS
+				blinking = plugin->airspace.HasSelection()
+					? td.exitSec >= 0 && td.exitSec <= cjsLead * 60
+					: radarTarget.GetCorrelatedFlightPlan().GetSectorExitMinutes() <= 2
+					&& radarTarget.GetCorrelatedFlightPlan().GetSectorExitMinutes() >= 0;
 			}
-			else {
-				string callsign = radarTarget.GetCallsign();
-
-				isBlinking.erase(callsign);
+			else if (plugin->airspace.HasSelection() && td.entrySec >= 0 && td.entrySec <= cjsLead * 60
+				&& strcmp(radarTarget.GetCorrelatedFlightPlan().GetTrackingControllerId(), "") != 0) {
+				blinking = TRUE;
 			}
 
 			// if in the process of handing off, flash the PPS (to be added), CJS and display the frequency 
-			if (strcmp(radarTarget.GetCorrelatedFlightPlan().GetHandoffTargetControllerId(), "") != 0
+			if (!keepAll && !onRadarArea && frameBudget.Drops(DEGRADE_CJS)) {
+				// off the radar area and over budget, no CJS text
+			}
+			else if (strcmp(radarTarget.GetCorrelatedFlightPlan().GetHandoffTargetControllerId(), "") != 0
 				&& radarTarget.GetCorrelatedFlightPlan().GetTrackingControllerIsMe()
 				) {
-				string handOffFreq = "-" + to_string(GetPlugIn()->ControllerSelectByPositionId(radarTarget.GetCorrelatedFlightPlan().GetHandoffTargetControllerId()).GetPrimaryFrequency()).substr(0,6);
-				string handOffCJS = radarTarget.GetCorrelatedFlightPlan().GetHandoffTargetControllerId();
-
-				string handOffText = handOffCJS + handOffFreq;
-
-				CFont font;
-				LOGFONT lgfont;
-
-				memset(&lgfont, 0, sizeof(LOGFONT));
-				lgfont.lfWeight = 500;
-				strcpy_s(lgfont.lfFaceName, _T("EuroScope"));
-				lgfont.lfHeight = 12;
-				font.CreateFontIndirect(&lgfont);
-
-				dc.SetTextColor(RGB(255, 255, 255));
-
-				dc.SelectObject(font);
-				if (isBlinking.find(radarTarget.GetCallsign()) != isBlinking.end()
-					&& halfSecTick) {
-					handOffText=""; // blank CJS symbol drawing when blinked out
+				// target CJS then the first six characters of its frequency, e.g. "TOR-134.47"
+				const char* handOffCJS = radarTarget.GetCorrelatedFlightPlan().GetHandoffTargetControllerId();
+				InlineString<32> handOffText(handOffCJS);
+				handOffText.Append('-');
+				size_t freqAt = handOffText.size();
+				handOffText.Append(GetPlugIn()->ControllerSelectByPositionId(handOffCJS).GetPrimaryFrequency(), 6);
+				handOffText.Truncate(freqAt + 6);
+
+				dc.SetTextColor(inConflict ? RGB(209, 39, 27) : RGB(255, 255, 255));
+
+				dc.SelectObject(tagFont);
+				if (blinking && halfSecTick) {
+					handOffText.clear(); // blank CJS symbol drawing when blinked out
 				}
 
 				RECT rectCJS;
@@ -143,25 +413,17 @@ void CSiTRadar::OnRefresh(HDC hdc, int phase)
 				rectCJS.bottom = p.y;
 
 				dc.DrawText(handOffText.c_str(), &rectCJS, DT_LEFT);
-
-				DeleteObject(font);
 			}
 			else {
 
 				// show CJS for controller tracking aircraft
-				string CJS = radarTarget.GetCorrelatedFlightPlan().GetTrackingControllerId();
-
-				CFont font;
-				LOGFONT lgfont;
-
-				memset(&lgfont, 0, sizeof(LOGFONT));
-				lgfont.lfWeight = 500;
-				strcpy_s(lgfont.lfFaceName, _T("EuroScope"));
-				lgfont.lfHeight = 12;
-				font.CreateFontIndirect(&lgfont);
+				const char* CJS = radarTarget.GetCorrelatedFlightPlan().GetTrackingControllerId();
+				if (blinking && halfSecTick) {
+					CJS = "";
+				}
 
-				dc.SelectObject(font);
-				dc.SetTextColor(RGB(202, 205, 169));
+				dc.SelectObject(tagFont);
+				dc.SetTextColor(inConflict ? RGB(209, 39, 27) : RGB(202, 205, 169));
 
 				RECT rectCJS;
 				rectCJS.left = p.x - 6 ;
@@ -169,16 +431,80 @@ void CSiTRadar::OnRefresh(HDC hdc, int phase)
 				rectCJS.top = p.y - 18;
 				rectCJS.bottom = p.y;
 
-				dc.DrawText(CJS.c_str(), &rectCJS, DT_LEFT);
-
-				DeleteObject(font);
+				dc.DrawText(CJS, &rectCJS, DT_LEFT);
 			}
 
 			// plane halo looks at the <map> hashalo to see if callsign has a halo, if so, draws halo
-			if (hashalo.find(radarTarget.GetCallsign()) != hashalo.end()) {
+			if (hashalo.find(radarTarget.GetCallsign()) != hashalo.end()
+				&& (keepAll || !frameBudget.Drops(DEGRADE_HALOS) || PtInRect(&focus, p))) {
 				HaloTool::drawHalo(dc, p, halorad, pixnm);
 			}
 
+			// if ptl applied, queue it up; the end point was calculated when the target last updated
+			if (ptlAll || hasPTL.find(radarTarget.GetCallsign()) != hasPTL.end()) {
+				auto ptlEnd = ptlEnds.find(radarTarget.GetCallsign());
+				if (ptlEnd != ptlEnds.end() && td.gs > 0) {
+					// the end is from the reported position, so it moves with a smoothed PPS
+					POINT end = ConvertCoordFromPositionToPixel(ptlEnd->second);
+					end.x += p.x - pReported.x;
+					end.y += p.y - pReported.y;
+					ptlPoints.push_back(p);
+					ptlPoints.push_back(end);
+				}
+			}
+
+			// medium term conflict: minutes to the first loss of separation under the PPS
+			auto mtcd = mtcdConflicts.find(radarTarget.GetCallsign());
+			if (mtcd != mtcdConflicts.end() && !inConflict) {
+				InlineString<8> mtcdText("M");
+				mtcdText.Append(mtcd->second.minutes);
+
+				dc.SelectObject(tagFont);
+				dc.SetTextColor(RGB(230, 215, 20));
+
+				RECT rectMTCD;
+				rectMTCD.left = p.x - 6;
+				rectMTCD.right = p.x + 40;
+				rectMTCD.top = p.y + 6;
+				rectMTCD.bottom = p.y + 20;
+
+				dc.DrawText(mtcdText.c_str(), &rectMTCD, DT_LEFT);
+			}
+
+			// plugin data block: full when tracked by or being handed to us, limited otherwise.
+			// the text is only laid out again when the target's data changed; it is drawn after
+			// the loop, once every tag on the screen has been placed
+			if (onGnd) {
+				HGDIOBJ oldFont = dc.SelectObject(gndStyle.font);
+
+				TagLayout& layout = gndLayouts[radarTarget.GetCallsign()];
+				GndRadar::UpdateGndLayout(dc, layout, radarTarget.GetCallsign(), td);
+				gndToDraw.push_back({ &layout, p, GndRadar::Status(td, gndIdx) });
+
+				if (td.segment >= 0 && plugin->surface.Get(td.segment).kind == SURF_RUNWAY) {
+					rwyOccupants[td.segment]++;
+				}
+
+				dc.SelectObject(oldFont);
+			}
+			else if (tagsOn) {
+				CFlightPlan fp = radarTarget.GetCorrelatedFlightPlan();
+				bool detailed = fp.IsValid() && (fp.GetTrackingControllerIsMe()
+					|| (!myId.empty() && myId == fp.GetHandoffTargetControllerId())
+					|| (filtFlags[item.index] & TF_QUICKLOOK));
+
+				dc.SelectObject(tagFont);
+
+				auto layout = tagLayouts.find(radarTarget.GetCallsign());
+				if (layout == tagLayouts.end()) {
+					layout = tagLayouts.emplace(radarTarget.GetCallsign(), TagLayout()).first;
+				}
+				tagRender::UpdateLayout(dc, layout->second, radarTarget.GetCallsign(), td, detailed);
+				tagPlacer.Update(layout->first, p, &layout->second);
+
+				tagsToDraw.push_back({ &layout->first, &layout->second, p, inConflict });
+			}
+
 			// if squawking ident, PPS blinks -- skips drawing symbol every 0.5 seconds
 			if (radarTarget.GetPosition().GetTransponderI()
 				&& radarTarget.GetPosition().GetRadarFlags() != 0) {
@@ -220,7 +546,7 @@ void CSiTRadar::OnRefresh(HDC hdc, int phase)
 				&& isADSB) { // need to add ADSB equipment logic -- currently based on filed FP; no tag will display though. WIP
 
 				COLORREF targetPenColor;
-				targetPenColor = RGB(202, 205, 169); // amber colour
+				targetPenColor = inConflict ? RGB(209, 39, 27) : RGB(202, 205, 169); // amber colour, red in conflict
 				HPEN targetPen;
 				targetPen = CreatePen(PS_SOLID, 1, targetPenColor);
 				dc.SelectObject(targetPen);
@@ -247,7 +573,7 @@ void CSiTRadar::OnRefresh(HDC hdc, int phase)
 
 			if (radarTarget.GetPosition().GetRadarFlags() == 1) {
 				COLORREF targetPenColor;
-				targetPenColor = RGB(197, 38, 212); // magenta colour
+				targetPenColor = inConflict ? RGB(209, 39, 27) : RGB(197, 38, 212); // magenta colour, red in conflict
 				HPEN targetPen;
 				targetPen = CreatePen(PS_SOLID, 1, targetPenColor);
 				dc.SelectObject(targetPen);
@@ -267,16 +593,16 @@ void CSiTRadar::OnRefresh(HDC hdc, int phase)
 
 			// if RVSM draw the RVSM diamond
 
-			if ((radarTarget.GetCorrelatedFlightPlan().GetFlightPlanData().GetCapibilities() == 'L' || 
-				radarTarget.GetCorrelatedFlightPlan().GetFlightPlanData().GetCapibilities() == 'W' ||
-				radarTarget.GetCorrelatedFlightPlan().GetFlightPlanData().GetCapibilities() == 'Z' || // FAA RVSM
+			if ((td.capability == 'L' || 
+				td.capability == 'W' ||
+				td.capability == 'Z' || // FAA RVSM
 				isRVSM) // ICAO equpmnet code indicates RVSM -- contains 'W'
 
 				&& radarTarget.GetPosition().GetRadarFlags() != 0 && 
 				radarTarget.GetPosition().GetRadarFlags() != 1) {
 
 				COLORREF targetPenColor;
-				targetPenColor = RGB(202, 205, 169); // amber colour
+				targetPenColor = inConflict ? RGB(209, 39, 27) : RGB(202, 205, 169); // amber colour, red in conflict
 				HPEN targetPen;
 				targetPen = CreatePen(PS_SOLID, 1, targetPenColor);
 				dc.SelectObject(targetPen);
@@ -299,11 +625,11 @@ void CSiTRadar::OnRefresh(HDC hdc, int phase)
 			}
 			else {
 
-				if (strcmp(radarTarget.GetCorrelatedFlightPlan().GetFlightPlanData().GetPlanType(), "I") == 0 
+				if (td.planType == 'I' 
 					&& radarTarget.GetPosition().GetRadarFlags() != 0
 					&& radarTarget.GetPosition().GetRadarFlags() != 1) {
 					COLORREF targetPenColor;
-					targetPenColor = RGB(202, 205, 169); // white when squawking ident
+					targetPenColor = inConflict ? RGB(209, 39, 27) : RGB(202, 205, 169); // white when squawking ident
 					HPEN targetPen;
 					targetPen = CreatePen(PS_SOLID, 1, targetPenColor);
 					dc.SelectObject(targetPen);
@@ -335,13 +661,13 @@ void CSiTRadar::OnRefresh(HDC hdc, int phase)
 
 			
 			// if VFR
-			if (strcmp(radarTarget.GetCorrelatedFlightPlan().GetFlightPlanData().GetPlanType(), "V") == 0
+			if (td.planType == 'V'
 				&& radarTarget.GetPosition().GetTransponderC() == TRUE
 				&& radarTarget.GetPosition().GetRadarFlags() != 0
 				&& radarTarget.GetPosition().GetRadarFlags() != 1) {
 
 				COLORREF targetPenColor;
-				targetPenColor = RGB(242, 120, 57); // PPS orange color
+				targetPenColor = inConflict ? RGB(209, 39, 27) : RGB(242, 120, 57); // PPS orange color, red in conflict
 				HPEN targetPen;
 				targetPen = CreatePen(PS_SOLID, 1, targetPenColor);
 				dc.SelectObject(targetPen);
@@ -357,11 +683,126 @@ void CSiTRadar::OnRefresh(HDC hdc, int phase)
 
 				DeleteObject(targetPen);
 			}
+		}
+		frameBudget.Mark(STAGE_TARGETS);
+
+		// history dots, all with the one brush
+		if (!trailDots.empty()) {
+			HBRUSH dotBrush = CreateSolidBrush(RGB(120, 122, 100));
+			for (const POINT& d : trailDots) {
+				RECT r = { d.x - 1, d.y - 1, d.x + 1, d.y + 1 };
+				FillRect(dc, &r, dotBrush);
+			}
+			DeleteObject(dotBrush);
+		}
+
+		// occupied runways, red when more than one target is on the same one
+		for (auto& rwy : rwyOccupants) {
+			const SurfaceSegment& seg = plugin->surface.Get(rwy.first);
+			POINT a = ConvertCoordFromPositionToPixel(seg.a);
+			POINT b = ConvertCoordFromPositionToPixel(seg.b);
+
+			HPEN rwyPen = CreatePen(PS_SOLID, 3, rwy.second > 1 ? RGB(209, 39, 27) : RGB(202, 205, 169));
+			HGDIOBJ oldPen = dc.SelectObject(rwyPen);
+			dc.MoveTo(a.x, a.y);
+			dc.LineTo(b.x, b.y);
+			dc.SelectObject(oldPen);
+			DeleteObject(rwyPen);
+		}
+
+		// ground tags, with the style selected once for all of them
+		if (!gndToDraw.empty()) {
+			dc.SelectObject(gndStyle.font);
+			dc.SelectObject(gndStyle.background);
+			dc.SetBkMode(TRANSPARENT);
+			for (const GndDraw& g : gndToDraw) {
+				GndRadar::DrawGndTag(dc, gndStyle, g.p, g.sts, *g.layout);
+			}
+		}
 
-			// if ptl tag applied, draw it => not implemented
+		// only the tags whose target moved, and whatever they now land on, get placed again
+		if (tagsOn) {
+			tagPlacer.Resolve(leaderLen, tagAngle);
 
+			dc.SelectObject(tagFont);
+			dc.SelectObject(tagPen);
+			for (const TagDraw& t : tagsToDraw) {
+				dc.SetTextColor(t.inConflict ? RGB(209, 39, 27) : RGB(202, 205, 169));
+				tagRender::drawTag(dc, *t.layout, t.p, leaderLen, tagPlacer.Angle(*t.callsign));
+			}
 		}
 
+		if (tagPen != NULL) {
+			DeleteObject(tagPen);
+		}
+		frameBudget.Mark(STAGE_TAGS);
+
+		PTLTool::DrawPTLs(dc, ptlPoints);
+
+		// refresh governor: while something on the display is moving, ask for the next frame when
+		// the fastest target has moved about a pixel, but never more than XTRAP_MAX_FPS a second.
+		// ES redraws every second by itself, so slow movers at wide zoom need nothing extra
+		if (xtrapOn && xtrapMaxGs > 0 && pixnm > 0) {
+			double pxPerSec = xtrapMaxGs / 3600.0 * pixnm;
+			int ms = max((int)(1000 / pxPerSec), 1000 / XTRAP_MAX_FPS);
+			if (ms < 1000 && xtrapTimer == 0) {
+				ScheduleXtrapFrame(ms);
+			}
+		}
+
+		// closest points of approach; only the pairs with a member that updated are recalculated
+		if (cpaOn) {
+			UpdateCPAs();
+
+			FrameVector<POINT> cpaPoints;
+			FrameVector<CPALabel> cpaLabels;
+			FrameVector<bool> cpaLoss;
+			clock_t now = clock();
+
+			for (auto& cpa : cpaPairs) {
+				double tgo = cpa.second.tcpa - (double)(now - cpa.second.calcTime) / CLOCKS_PER_SEC / 60.0;
+				if (tgo <= 0 || tgo > cpaMaxTime) {
+					continue;
+				}
+
+				int secs = (int)round(tgo * 60);
+				CPALabel label;
+				label.Append(secs / 60).Append(':').Append(secs % 60 < 10 ? "0" : "").Append(secs % 60);
+				label.Append(' ').Append(cpa.second.dcpa, 1);
+
+				cpaPoints.push_back(ConvertCoordFromPositionToPixel(cpa.second.mid));
+				cpaLabels.push_back(label);
+				cpaLoss.push_back(cpa.second.dcpa < halorad);
+			}
+
+			CPATool::DrawCPAs(dc, cpaPoints, cpaLabels, cpaLoss);
+		}
+
+		// range bearing lines; range and bearing are kept up to date by the position updates
+		// and cursor moves, so all that is left here is the pixel conversion of the ends
+		FrameVector<POINT> rblPoints;
+		FrameVector<const char*> rblLabels;
+
+		for (size_t i = 0; i < rbls.size(); i++) {
+			rblPoints.push_back(ConvertCoordFromPositionToPixel(rbls[i].a.pos));
+			rblPoints.push_back(ConvertCoordFromPositionToPixel(rbls[i].b.pos));
+			rblLabels.push_back(rbls[i].label.c_str());
+
+			POINT lp = RBLTool::LabelPoint(rblPoints[2 * i], rblPoints[2 * i + 1]);
+			RECT lrect = { lp.x, lp.y, lp.x + 50, lp.y + 12 };
+			InlineString<12> id;
+			id.Append((int)i);
+			AddScreenObject(RBL_LINE, id.c_str(), lrect, FALSE, "");
+		}
+
+		if (rblPending) {
+			rblPoints.push_back(ConvertCoordFromPositionToPixel(rblCursor.a.pos));
+			rblPoints.push_back(rblCursorPt);
+			rblLabels.push_back(rblCursor.label.c_str());
+		}
+
+		RBLTool::DrawRBLs(dc, rblPoints, rblLabels);
+
 		// Flight plan loop. Goes through flight plans, and if not correlated will display
 		for (CFlightPlan flightPlan = GetPlugIn()->FlightPlanSelectFirst(); flightPlan.IsValid();
 			flightPlan = GetPlugIn()->FlightPlanSelectNext(flightPlan)) {
@@ -421,6 +862,8 @@ void CSiTRadar::OnRefresh(HDC hdc, int phase)
 		}
 
 
+		frameBudget.Mark(STAGE_OVERLAYS);
+
 		// Draw the CSiT Tools Menu; starts at rad area top left then moves right
 		// this point moves to the origin of each subsequent area
 		POINT menutopleft = CPoint(radarea.left, radarea.top); 
@@ -444,13 +887,15 @@ void CSiTRadar::OnRefresh(HDC hdc, int phase)
 		
 		// horizontal range calculation
 		int range = (int)round(RadRange());
-		string rng = to_string(range);
+		InlineString<12> rng;
+		rng.Append(range);
 		TopMenu::MakeText(dc, menutopleft, 50, 15, "Range");
 		menutopleft.y += 15;
 
 		// 109 pix per in on my monitor
 		int nmIn = 109 / pixnm;
-		string nmtext = "1\" = " + to_string(nmIn) + "nm";
+		InlineString<16> nmtext("1\" = ");
+		nmtext.Append(nmIn).Append("nm");
 		TopMenu::MakeText(dc, menutopleft, 50, 15, nmtext.c_str());
 		menutopleft.y += 17;
 
@@ -466,39 +911,93 @@ void CSiTRadar::OnRefresh(HDC hdc, int phase)
 		
 		menutopleft.y += 25;
 
-		string altFilterLowFL = to_string(altFilterLow);
-		altFilterLowFL.insert(altFilterLowFL.begin(), 3 - altFilterLowFL.size(), '0');
-		string altFilterHighFL = to_string(altFilterHigh);
-		altFilterHighFL.insert(altFilterHighFL.begin(), 3 - altFilterHighFL.size(), '0');
-
-		string filtText = altFilterLowFL + string(" - ") + altFilterHighFL;
+		// flight levels are shown with three digits
+		auto flText = [](int fl) {
+			InlineString<8> t;
+			t.Append(fl < 100 ? "0" : "").Append(fl < 10 ? "0" : "").Append(fl);
+			return t;
+		};
+		InlineString<8> altFilterLowFL = flText(altFilterLow);
+		InlineString<8> altFilterHighFL = flText(altFilterHigh);
+
+		InlineString<20> filtText(altFilterLowFL.c_str());
+		filtText.Append(" - ").Append(altFilterHighFL.c_str());
 		but = TopMenu::DrawButton(dc, menutopleft, 50, 23, filtText.c_str(), altFilterOn);
 		ButtonToScreen(this, but, "", BUTTON_MENU_ALT_FILT_ON);
 		menutopleft.y -= 25;
 		menutopleft.x += 65; 
 
 		// separation tools
-		string haloText = "Halo " + halooptions[haloidx];
+		InlineString<16> haloText("Halo ");
+		haloText.Append(halooptions[haloidx].c_str());
 		but = TopMenu::DrawButton(dc, menutopleft, 45, 23, haloText.c_str(), halotool);
 		ButtonToScreen(this, but, "Halo", BUTTON_MENU_HALO_OPTIONS);
 
 		menutopleft.y = menutopleft.y + 25;
-		but = TopMenu::DrawButton(dc, menutopleft, 45, 23, "PTL 3", 0);
-		ButtonToScreen(this, but, "PTL", BUTTON_MENU_HALO_OPTIONS);
+		InlineString<16> ptlText("PTL ");
+		ptlText.Append(ptloptions[ptlidx].c_str());
+		but = TopMenu::DrawButton(dc, menutopleft, 45, 23, ptlText.c_str(), ptltool);
+		ButtonToScreen(this, but, "PTL", BUTTON_MENU_PTL_OPTIONS);
 
 		menutopleft.y = menutopleft.y - 25;
 		menutopleft.x = menutopleft.x + 47;
-		TopMenu::DrawButton(dc, menutopleft, 35, 23, "RBL", 0);
+		but = TopMenu::DrawButton(dc, menutopleft, 35, 23, "RBL", rbltool);
+		ButtonToScreen(this, but, "RBL", BUTTON_MENU_RBL);
 
 		menutopleft.y = menutopleft.y + 25;
 		TopMenu::DrawButton(dc, menutopleft, 35, 23, "PIV", 0);
 
 		menutopleft.y = menutopleft.y - 25;
 		menutopleft.x = menutopleft.x + 37;
-		TopMenu::DrawButton(dc, menutopleft, 50, 23, "Rings 20", 0);
+		InlineString<16> ringsText("Rings ");
+		ringsText.Append(ringoptions[ringidx].c_str());
+		but = TopMenu::DrawButton(dc, menutopleft, 50, 23, ringsText.c_str(), ringsOn);
+		ButtonToScreen(this, but, "Rings", BUTTON_MENU_RINGS);
 
 		menutopleft.y = menutopleft.y + 25;
-		TopMenu::DrawButton(dc, menutopleft, 50, 23, "Grid", 0);
+		but = TopMenu::DrawButton(dc, menutopleft, 50, 23, "Grid", gridOn);
+		ButtonToScreen(this, but, "Grid", BUTTON_MENU_GRID);
+
+		menutopleft.y -= 25;
+		menutopleft.x += 52;
+		but = TopMenu::DrawButton(dc, menutopleft, 35, 23, "Tags", tagsOn);
+		ButtonToScreen(this, but, "Tags", BUTTON_MENU_TAGS);
+
+		menutopleft.y += 25;
+		but = TopMenu::DrawButton(dc, menutopleft, 35, 23, "Gnd", gndMode);
+		ButtonToScreen(this, but, "Gnd", BUTTON_MENU_GND);
+		rGndAirport = but;
+		menutopleft.y -= 25;
+
+		menutopleft.x += 37;
+		but = TopMenu::DrawButton(dc, menutopleft, 35, 23, "Map", mapLayers != 0);
+		ButtonToScreen(this, but, "Map", BUTTON_MENU_MAP);
+
+		menutopleft.y += 25;
+		InlineString<16> histText("Hist ");
+		histText.Append(histoptions[histidx].c_str());
+		but = TopMenu::DrawButton(dc, menutopleft, 35, 23, histText.c_str(), trailLen > 0);
+		ButtonToScreen(this, but, "Hist", BUTTON_MENU_HIST);
+		menutopleft.y -= 25;
+
+		menutopleft.x += 37;
+		but = TopMenu::DrawButton(dc, menutopleft, 40, 23, "Xtrap", xtrapOn);
+		ButtonToScreen(this, but, "Xtrap", BUTTON_MENU_XTRAP);
+
+		menutopleft.y += 25;
+		but = TopMenu::DrawButton(dc, menutopleft, 40, 23, "Stats", statsOn);
+		ButtonToScreen(this, but, "Stats", BUTTON_MENU_STATS);
+		menutopleft.y -= 25;
+
+		menutopleft.x += 42;
+		but = TopMenu::DrawButton(dc, menutopleft, 35, 23, "Clst", clusterOn);
+		ButtonToScreen(this, but, "Clst", BUTTON_MENU_CLUSTER);
+		rCluster = but;
+
+		menutopleft.y += 25;
+		but = TopMenu::DrawButton(dc, menutopleft, 35, 23, "Dens", densityOn);
+		ButtonToScreen(this, but, "Dens", BUTTON_MENU_DENSITY);
+		menutopleft.y -= 25;
 
 		// get the controller position ID and display it (aesthetics :) )
 		if (GetPlugIn()->ControllerMyself().IsValid())
@@ -506,14 +1005,16 @@ void CSiTRadar::OnRefresh(HDC hdc, int phase)
 			controllerID = GetPlugIn()->ControllerMyself().GetPositionId();
 		}
 
-		menutopleft.y -= 25;
 		menutopleft.x += 60;
-		string cid = "CJS - " + controllerID;
+		InlineString<32> cid("CJS - ");
+		cid.Append(controllerID.c_str());
 
 		RECT r = TopMenu::DrawButton2(dc, menutopleft, 50, 23, cid.c_str(), 0);
+		ButtonToScreen(this, r, "CJS", BUTTON_MENU_CJS);
 
 		menutopleft.y += 25;
-		TopMenu::DrawButton(dc, menutopleft, 50, 23, "Qck Look", 0);
+		r = TopMenu::DrawButton(dc, menutopleft, 50, 23, "Qck Look", !quickLook.empty());
+		ButtonToScreen(this, r, "Qck Look", BUTTON_MENU_QUICK_LOOK);
 		menutopleft.y -= 25;
 
 		menutopleft.x = menutopleft.x + 100;
@@ -541,12 +1042,87 @@ void CSiTRadar::OnRefresh(HDC hdc, int phase)
 				rect.top = menutopleft.y + 31;
 				rect.right = menutopleft.x + 127;
 				rect.bottom = menutopleft.y + 46;
-				string key = to_string(idx);
-				AddScreenObject(BUTTON_MENU_HALO_OPTIONS, key.c_str(), rect, 0, "");
+				char key[2] = { (char)('0' + idx), '\0' };
+				AddScreenObject(BUTTON_MENU_HALO_OPTIONS, key, rect, 0, "");
 				menutopleft.x += 22;
 			}
 			r = TopMenu::DrawButton(dc, menutopleft, 35, 46, "Mouse", mousehalo);
 			ButtonToScreen(this, r, "Mouse", BUTTON_MENU_HALO_OPTIONS);
+			menutopleft.x += 35;
+
+			// cpa markers for haloed pairs; right click sets the search radius
+			r = TopMenu::DrawButton(dc, menutopleft, 35, 46, "CPA", cpaOn);
+			ButtonToScreen(this, r, "CPA", BUTTON_MENU_HALO_OPTIONS);
+			menutopleft.x += 35;
+			r = TopMenu::DrawButton(dc, menutopleft, 35, 46, "CPA All", cpaAll);
+			ButtonToScreen(this, r, "CPA All", BUTTON_MENU_HALO_OPTIONS);
+		}
+
+		// options for ptl length
+		if (ptltool) {
+			TopMenu::DrawHaloRadOptions(dc, menutopleft, ptlLen, ptloptions);
+			RECT rect;
+			RECT r;
+
+			r = TopMenu::DrawButton(dc, menutopleft, 35, 46, "End", FALSE);
+			ButtonToScreen(this, r, "End", BUTTON_MENU_PTL_OPTIONS);
+			menutopleft.x += 35;
+
+			r = TopMenu::DrawButton(dc, menutopleft, 35, 46, "All On", ptlAll);
+			ButtonToScreen(this, r, "All On", BUTTON_MENU_PTL_OPTIONS);
+			menutopleft.x += 35;
+			r = TopMenu::DrawButton(dc, menutopleft, 35, 46, "Clr All", FALSE);
+			ButtonToScreen(this, r, "Clr All", BUTTON_MENU_PTL_OPTIONS);
+			menutopleft.x += 35;
+
+			for (int idx = 0; idx < 9; idx++) {
+
+				rect.left = menutopleft.x;
+				rect.top = menutopleft.y + 31;
+				rect.right = menutopleft.x + 20;
+				rect.bottom = menutopleft.y + 46;
+				char key[2] = { (char)('0' + idx), '\0' };
+				AddScreenObject(BUTTON_MENU_PTL_OPTIONS, key, rect, 0, "");
+				menutopleft.x += 22;
+			}
+		}
+
+		// options for the rbl tool
+		if (rbltool) {
+			r = TopMenu::DrawButton(dc, menutopleft, 35, 46, "End", FALSE);
+			ButtonToScreen(this, r, "End", BUTTON_MENU_RBL);
+			menutopleft.x += 35;
+			r = TopMenu::DrawButton(dc, menutopleft, 35, 46, "Clr All", FALSE);
+			ButtonToScreen(this, r, "Clr All", BUTTON_MENU_RBL);
+			menutopleft.x += 35;
+		}
+
+		// options for the range rings
+		if (ringsMenu) {
+			TopMenu::DrawHaloRadOptions(dc, menutopleft, ringSpacing, ringoptions);
+			RECT rect;
+			RECT r;
+
+			r = TopMenu::DrawButton(dc, menutopleft, 35, 46, "End", FALSE);
+			ButtonToScreen(this, r, "End", BUTTON_MENU_RINGS);
+			menutopleft.x += 35;
+			r = TopMenu::DrawButton(dc, menutopleft, 35, 46, "On", ringsOn);
+			ButtonToScreen(this, r, "On", BUTTON_MENU_RINGS);
+			menutopleft.x += 35;
+			r = TopMenu::DrawButton(dc, menutopleft, 35, 46, "Centre", ringCentrePick);
+			ButtonToScreen(this, r, "Centre", BUTTON_MENU_RINGS);
+			menutopleft.x += 35;
+
+			for (int idx = 0; idx < 9; idx++) {
+
+				rect.left = menutopleft.x;
+				rect.top = menutopleft.y + 31;
+				rect.right = menutopleft.x + 20;
+				rect.bottom = menutopleft.y + 46;
+				char key[2] = { (char)('0' + idx), '\0' };
+				AddScreenObject(BUTTON_MENU_RINGS, key, rect, 0, "");
+				menutopleft.x += 22;
+			}
 		}
 
 		// options for the altitude filter sub menu
@@ -570,31 +1146,52 @@ void CSiTRadar::OnRefresh(HDC hdc, int phase)
 			rLLim = TopMenu::MakeField(dc, menutopleft, 55, 15, altFilterLowFL.c_str());
 			AddScreenObject(BUTTON_MENU_ALT_FILT_OPT, "LLim", rLLim, 0, "");
 
-			menutopleft.x += 75;
+			// more bands, and a floor VFR are hidden below
+			menutopleft.x += 65;
+			menutopleft.y -= 20;
+			TopMenu::MakeText(dc, menutopleft, 45, 15, "Bands");
+			menutopleft.x += 45;
+			rBands = TopMenu::MakeField(dc, menutopleft, 95, 15, altFilterBands.empty() ? "-" : altFilterBands.c_str());
+			AddScreenObject(BUTTON_MENU_ALT_FILT_OPT, "Bands", rBands, 0, "");
+
+			menutopleft.x -= 45; menutopleft.y += 20;
+
+			TopMenu::MakeText(dc, menutopleft, 45, 15, "VFR Flr");
+			menutopleft.x += 45;
+			InlineString<8> vfrFloorFL = flText(altFilterVfrFloor);
+			rVfrFloor = TopMenu::MakeField(dc, menutopleft, 95, 15, altFilterVfrFloor > 0 ? vfrFloorFL.c_str() : "-");
+			AddScreenObject(BUTTON_MENU_ALT_FILT_OPT, "VFR Flr", rVfrFloor, 0, "");
+
+			// owned, emergency and haloed targets shown whatever the filter
+			menutopleft.x += 105;
 			menutopleft.y -= 25;
+			r = TopMenu::DrawButton(dc, menutopleft, 35, 46, "Keep", altFilterKeep != 0);
+			AddScreenObject(BUTTON_MENU_ALT_FILT_OPT, "Keep", r, 0, "");
+
+			menutopleft.x += 45;
 			r = TopMenu::DrawButton(dc, menutopleft, 35, 46, "Save", FALSE);
 			AddScreenObject(BUTTON_MENU_ALT_FILT_OPT, "Save", r, 0, "");
 
 		}
-/*
-		// Ground Radar Tags WIP
-
-		for (CRadarTarget rt = GetPlugIn()->RadarTargetSelectFirst(); rt.IsValid(); rt = GetPlugIn()->RadarTargetSelectNext(rt))
-		{
-			if (!rt.IsValid())
-				continue;
-
-			if (strcmp(rt.GetCorrelatedFlightPlan().GetFlightPlanData().GetDestination(), "CYYZ")) {
-
-				POINT p = ConvertCoordFromPositionToPixel(rt.GetPosition().GetPosition());
-				GndRadar::DrawGndTag(dc, p, 0, rt, rt.GetCallsign());
-			}
+		frameBudget.Mark(STAGE_MENU);
+		frameBudget.End();
+#ifdef _DEBUG
+		frameBudget.SetHeapAllocs(FrameAllocCounter::End());
+#endif
+
+		// frame timing and the degradation level along the bottom of the radar area
+		if (statsOn) {
+			InlineString<160> stats = frameBudget.StatsLine();
+			RECT rStats = { radarea.left + 10, radarea.bottom - 20, radarea.right, radarea.bottom };
+			dc.SetTextColor(frameBudget.Level() > DEGRADE_NONE ? RGB(242, 120, 57) : RGB(202, 205, 169));
+			dc.DrawText(stats.c_str(), &rStats, DT_LEFT);
 		}
-
-*/
 	}
 	g.ReleaseHDC(hdc);
 	dc.Detach();
+
+	// nothing from this refresh is still alive, so the frame arena can start over
+	FrameArena::Frame().Reset();
 }
 
 void CSiTRadar::OnClickScreenObject(int ObjectType,
@@ -610,12 +1207,229 @@ void CSiTRadar::OnClickScreenObject(int ObjectType,
 
 		if (hashalo.find(callsign) != hashalo.end()) {
 			hashalo.erase(callsign);
+			static_cast<SituPlugin*>(GetPlugIn())->SetHalo(callsign, FALSE);
 		}
 		else {
 			hashalo[callsign] = TRUE;
+			static_cast<SituPlugin*>(GetPlugIn())->SetHalo(callsign, TRUE);
+		}
+		if (cpaOn) {
+			cpaDirty.insert(callsign);
+		}
+	}
+
+	if (ObjectType == AIRCRAFT_SYMBOL && ptltool == TRUE) {
+
+		string callsign = sObjectId;
+
+		if (hasPTL.find(callsign) != hasPTL.end()) {
+			hasPTL.erase(callsign);
+		}
+		else {
+			hasPTL[callsign] = TRUE;
+			ptlDirty.insert(callsign);
 		}
 	}
 
+	// placing an RBL end on a target or on the map
+	if ((ObjectType == AIRCRAFT_SYMBOL || ObjectType == SCREEN_BACKGROUND) && rbltool == TRUE) {
+		if (Button == BUTTON_RIGHT) {
+			rblPending = FALSE;
+		}
+		else if (Button == BUTTON_LEFT) {
+			RBLAnchor anchor;
+
+			const TargetData* td = static_cast<SituPlugin*>(GetPlugIn())->targets.Find(sObjectId);
+			if (ObjectType == AIRCRAFT_SYMBOL && td != nullptr) {
+				anchor.callsign = sObjectId;
+				anchor.pos = td->pos;
+			}
+			else {
+				anchor.pos = ConvertCoordFromPixelToPosition(Pt);
+			}
+
+			// the variation is taken once from the sector file, all later bearings are plugin side
+			if (!magVarSet) {
+				magVar = Geodesy::MagVar(anchor.pos);
+				magVarSet = TRUE;
+			}
+
+			if (!rblPending) {
+				rblCursor.a = anchor;
+				rblCursor.b = anchor;
+				rblCursorPt = Pt;
+				RBLTool::CalcRBL(rblCursor, magVar);
+				rblPending = TRUE;
+			}
+			else {
+				RBL rbl;
+				rbl.a = rblCursor.a;
+				rbl.b = anchor;
+				RBLTool::CalcRBL(rbl, magVar);
+				rbls.push_back(rbl);
+
+				rblPending = FALSE;
+				rbltool = FALSE;
+			}
+		}
+	}
+
+	// new centre for the range rings
+	if (ObjectType == SCREEN_BACKGROUND && ringCentrePick == TRUE && Button == BUTTON_LEFT) {
+		ringCentre = ConvertCoordFromPixelToPosition(Pt);
+		ringCentreSet = TRUE;
+		ringCentrePick = FALSE;
+		ringsGridCache.valid = FALSE;
+		RefreshMapContent();
+
+		SaveDataToAsr("ringLat", "Range Rings Centre Latitude", to_string(ringCentre.m_Latitude).c_str());
+		SaveDataToAsr("ringLon", "Range Rings Centre Longitude", to_string(ringCentre.m_Longitude).c_str());
+	}
+
+	// right click on the label removes that line
+	if (ObjectType == RBL_LINE && Button == BUTTON_RIGHT) {
+		size_t idx = atoi(sObjectId);
+		if (idx < rbls.size()) {
+			rbls.erase(rbls.begin() + idx);
+		}
+	}
+
+	if (ObjectType == BUTTON_MENU_RBL) {
+		if (!strcmp(sObjectId, "RBL")) { rbltool = !rbltool; rblPending = FALSE; halotool = FALSE; ptltool = FALSE; }
+		if (!strcmp(sObjectId, "End")) { rbltool = FALSE; rblPending = FALSE; }
+		if (!strcmp(sObjectId, "Clr All")) { rbls.clear(); rblPending = FALSE; }
+	}
+
+	// the rings and grid live in the back bitmap, so any change needs the map content redrawn
+	if (ObjectType == BUTTON_MENU_RINGS) {
+		if (!strcmp(sObjectId, "Rings")) { ringsMenu = !ringsMenu; }
+		if (!strcmp(sObjectId, "End")) { ringsMenu = FALSE; ringCentrePick = FALSE; }
+		if (!strcmp(sObjectId, "On")) { ringsOn = !ringsOn; }
+		if (!strcmp(sObjectId, "Centre")) { ringCentrePick = !ringCentrePick; }
+
+		if (strlen(sObjectId) == 1 && isdigit(sObjectId[0])) {
+			ringidx = sObjectId[0] - '0';
+			ringSpacing = stod(ringoptions[ringidx]);
+
+			SaveDataToAsr("ringSpacing", "Range Rings Spacing", ringoptions[ringidx].c_str());
+		}
+
+		ringsGridCache.valid = FALSE;
+		RefreshMapContent();
+	}
+
+	if (ObjectType == BUTTON_MENU_GRID) {
+		gridOn = !gridOn;
+		ringsGridCache.valid = FALSE;
+		RefreshMapContent();
+	}
+
+	// left click toggles ground mode, right click picks the aerodrome
+	if (ObjectType == BUTTON_MENU_GND) {
+		if (Button == BUTTON_RIGHT) {
+			GetPlugIn()->OpenPopupEdit(rGndAirport, FUNCTION_GND_AIRPORT, gndAirport.c_str());
+		}
+		else {
+			gndMode = !gndMode;
+
+			// default to the aerodrome in our own callsign, else the one nearest the middle of the screen
+			if (gndMode && gndAirport.empty()) {
+				SituPlugin* plugin = static_cast<SituPlugin*>(GetPlugIn());
+				string cs = GetPlugIn()->ControllerMyself().IsValid() ? GetPlugIn()->ControllerMyself().GetCallsign() : "";
+				if (cs.size() >= 4 && plugin->airports.Find(cs.substr(0, 4)) >= 0) {
+					gndAirport = cs.substr(0, 4);
+				}
+				else {
+					CPosition ll, ur, mid;
+					GetDisplayArea(&ll, &ur);
+					mid.m_Latitude = (ll.m_Latitude + ur.m_Latitude) / 2;
+					mid.m_Longitude = (ll.m_Longitude + ur.m_Longitude) / 2;
+					int idx = plugin->airports.Nearest(mid, 50);
+					if (idx >= 0) {
+						gndAirport = plugin->airports.Get(idx).icao;
+					}
+				}
+			}
+		}
+	}
+
+	// history dots, cycles through the lengths
+	if (ObjectType == BUTTON_MENU_HIST) {
+		histidx = (histidx + 1) % 4;
+		trailLen = stoi(histoptions[histidx]);
+		SaveDataToAsr("situHist", "History Dots", histoptions[histidx].c_str());
+	}
+
+	// smooth PPS motion between radar updates
+	if (ObjectType == BUTTON_MENU_XTRAP) {
+		xtrapOn = !xtrapOn;
+		SaveDataToAsr("situXtrap", "Smooth Target Motion", xtrapOn ? "1" : "0");
+	}
+
+	// clustering at wide ranges; right click for the range it starts at
+	if (ObjectType == BUTTON_MENU_CLUSTER) {
+		if (Button == BUTTON_RIGHT) {
+			GetPlugIn()->OpenPopupEdit(rCluster, FUNCTION_CLUSTER_RANGE, to_string(clusterRange).c_str());
+		}
+		else {
+			clusterOn = !clusterOn;
+			SaveDataToAsr("situCluster", "Target Clustering", clusterOn ? "1" : "0");
+		}
+	}
+	if (ObjectType == BUTTON_MENU_DENSITY) {
+		densityOn = !densityOn;
+		SaveDataToAsr("situDensity", "Cluster Heatmap", densityOn ? "1" : "0");
+	}
+
+	// frame timing line
+	if (ObjectType == BUTTON_MENU_STATS) {
+		statsOn = !statsOn;
+		SaveDataToAsr("situStats", "Frame Stats", statsOn ? "1" : "0");
+	}
+
+	// video map layers, each one ticked on or off
+	if (ObjectType == BUTTON_MENU_MAP) {
+		static const char* layerNames[VMAP_LAYERS] = { "Boundaries", "Airways", "Geo" };
+		GetPlugIn()->OpenPopupList(Area, "Map", 1);
+		for (int l = 0; l < VMAP_LAYERS; l++) {
+			GetPlugIn()->AddPopupListElement(layerNames[l], "", FUNCTION_MAP_LAYER, false,
+				mapLayers & (1 << l) ? POPUP_ELEMENT_CHECKED : POPUP_ELEMENT_UNCHECKED);
+		}
+	}
+
+	// left click picks the sectors that count as our airspace, right click sets the warning lead time
+	if (ObjectType == BUTTON_MENU_CJS) {
+		SituPlugin* plugin = static_cast<SituPlugin*>(GetPlugIn());
+		if (Button == BUTTON_RIGHT) {
+			GetPlugIn()->OpenPopupEdit(Area, FUNCTION_CJS_LEAD, to_string(cjsLead).c_str());
+		}
+		else if (plugin->airspace.Count() > 0) {
+			GetPlugIn()->OpenPopupList(Area, "Sectors", 1);
+			for (int i = 0; i < plugin->airspace.Count(); i++) {
+				const string& name = plugin->airspace.Get(i).name;
+				bool sel = plugin->airspace.Selected().count(name) > 0;
+				GetPlugIn()->AddPopupListElement(name.c_str(), "", FUNCTION_CJS_SECTOR, false,
+					sel ? POPUP_ELEMENT_CHECKED : POPUP_ELEMENT_UNCHECKED);
+			}
+		}
+	}
+
+	// quick look: tick the positions whose targets are shown in full
+	if (ObjectType == BUTTON_MENU_QUICK_LOOK) {
+		map<string, int> positions = static_cast<SituPlugin*>(GetPlugIn())->targets.Owners().Positions();
+		GetPlugIn()->OpenPopupList(Area, "Qck Look", 2);
+		for (const auto& pos : positions) {
+			GetPlugIn()->AddPopupListElement(pos.first.c_str(), to_string(pos.second).c_str(), FUNCTION_QUICK_LOOK, false,
+				quickLook.count(pos.first) ? POPUP_ELEMENT_CHECKED : POPUP_ELEMENT_UNCHECKED);
+		}
+		GetPlugIn()->AddPopupListElement("Clear", "", FUNCTION_QUICK_LOOK, false, POPUP_ELEMENT_NO_CHECKBOX, quickLook.empty());
+	}
+
+	if (ObjectType == BUTTON_MENU_TAGS) {
+		tagsOn = !tagsOn;
+		SaveDataToAsr("situTags", "Plugin Data Tags", tagsOn ? "1" : "0");
+	}
+
 	if (ObjectType == BUTTON_MENU_HALO_OPTIONS) {
 		if (!strcmp(sObjectId, "0")) { halorad = 0.5; haloidx = 0; }
 		if (!strcmp(sObjectId, "1")) { halorad = 3; haloidx = 1; }
@@ -626,10 +1440,56 @@ void CSiTRadar::OnClickScreenObject(int ObjectType,
 		if (!strcmp(sObjectId, "6")) { halorad = 30; haloidx = 6; }
 		if (!strcmp(sObjectId, "7")) { halorad = 60; haloidx = 7; }
 		if (!strcmp(sObjectId, "8")) { halorad = 80; haloidx = 8; }
-		if (!strcmp(sObjectId, "Clr All")) { hashalo.clear(); }
+		if (!strcmp(sObjectId, "Clr All")) {
+			if (cpaOn) {
+				for (auto& h : hashalo) { cpaDirty.insert(h.first); }
+			}
+			ClearHalos();
+		}
 		if (!strcmp(sObjectId, "End")) { halotool = !halotool; }
 		if (!strcmp(sObjectId, "Mouse")) { mousehalo = !mousehalo; }
-		if (!strcmp(sObjectId, "Halo")) { halotool = !halotool; }
+		if (!strcmp(sObjectId, "CPA")) {
+			if (Button == BUTTON_RIGHT) {
+				GetPlugIn()->OpenPopupEdit(Area, FUNCTION_CPA_RADIUS, to_string((int)cpaRadius).c_str());
+			}
+			else {
+				cpaOn = !cpaOn;
+				MarkAllCPADirty();
+			}
+		}
+		if (!strcmp(sObjectId, "CPA All")) { cpaAll = !cpaAll; MarkAllCPADirty(); }
+		if (!strcmp(sObjectId, "Halo")) { halotool = !halotool; ptltool = FALSE; }
+	}
+
+	if (ObjectType == BUTTON_MENU_PTL_OPTIONS) {
+		if (!strcmp(sObjectId, "PTL")) { ptltool = !ptltool; halotool = FALSE; }
+		if (!strcmp(sObjectId, "End")) { ptltool = FALSE; }
+		if (!strcmp(sObjectId, "All On")) {
+			ptlAll = !ptlAll;
+
+			// end points were only kept for the targets with a PTL, the rest catch up on the next refresh
+			if (ptlAll) {
+				for (auto& td : static_cast<SituPlugin*>(GetPlugIn())->targets.Targets()) {
+					ptlDirty.insert(td.first);
+				}
+			}
+		}
+		if (!strcmp(sObjectId, "Clr All")) { hasPTL.clear(); ptlAll = FALSE; ptlEnds.clear(); }
+
+		// length options are the single digit keys
+		if (strlen(sObjectId) == 1 && isdigit(sObjectId[0])) {
+			ptlidx = sObjectId[0] - '0';
+			ptlLen = stod(ptloptions[ptlidx]);
+
+			// gs and track are in the target store, so the new end points do not need the SDK
+			for (auto& td : static_cast<SituPlugin*>(GetPlugIn())->targets.Targets()) {
+				if (ptlAll || hasPTL.find(td.first) != hasPTL.end()) {
+					ptlEnds[td.first] = PTLTool::CalcPTLEnd(td.second.pos, td.second.trk, td.second.gs, ptlLen);
+				}
+			}
+
+			SaveDataToAsr("ptlLength", "PTL Length", ptloptions[ptlidx].c_str());
+		}
 	}
 
 	if (ObjectType == BUTTON_MENU_ALT_FILT_OPT) {
@@ -645,17 +1505,35 @@ void CSiTRadar::OnClickScreenObject(int ObjectType,
 			altFilterHighFL.insert(altFilterHighFL.begin(), 3 - altFilterHighFL.size(), '0');
 			GetPlugIn()->OpenPopupEdit(rHLim, FUNCTION_ALT_FILT_HIGH, altFilterHighFL.c_str());
 		}
+		if (!strcmp(sObjectId, "Bands")) {
+			GetPlugIn()->OpenPopupEdit(rBands, FUNCTION_ALT_FILT_BANDS, altFilterBands.c_str());
+		}
+		if (!strcmp(sObjectId, "VFR Flr")) {
+			string vfrFloorFL = to_string(altFilterVfrFloor);
+			vfrFloorFL.insert(vfrFloorFL.begin(), 3 - min(vfrFloorFL.size(), (size_t)3), '0');
+			GetPlugIn()->OpenPopupEdit(rVfrFloor, FUNCTION_ALT_FILT_VFR, vfrFloorFL.c_str());
+		}
+		if (!strcmp(sObjectId, "Keep")) {
+			altFilterKeep = altFilterKeep != 0 ? 0 : TF_KEEP_ALL;
+			CompileAltFilter();
+		}
 		if (!strcmp(sObjectId, "Save")) {
 			string s = to_string(altFilterHigh);
 			SaveDataToAsr("altFilterHigh", "Alt Filter High Limit", s.c_str());
 			s = to_string(altFilterLow);
 			SaveDataToAsr("altFilterLow", "Alt Filter Low Limit", s.c_str());
+			SaveDataToAsr("altFilterBands", "Alt Filter Bands", altFilterBands.c_str());
+			s = to_string(altFilterVfrFloor);
+			SaveDataToAsr("altFilterVfrFloor", "Alt Filter VFR Floor", s.c_str());
+			s = to_string(altFilterKeep);
+			SaveDataToAsr("altFilterKeep", "Alt Filter Exceptions", s.c_str());
 			altFilterOpts = 0;
 		}
 	}
 
 	if (ObjectType == BUTTON_MENU_ALT_FILT_ON) {
 		altFilterOn = !altFilterOn;
+		CompileAltFilter();
 	}
 
 	
@@ -687,19 +1565,298 @@ void CSiTRadar::OnFunctionCall(int FunctionId,
 	if (FunctionId == FUNCTION_ALT_FILT_LOW) {
 		try {
 			altFilterLow = stoi(sItemString);
+			CompileAltFilter();
 		}
 		catch (...) {}
 	}
 	if (FunctionId == FUNCTION_ALT_FILT_HIGH) {
 		try {
 			altFilterHigh = stoi(sItemString);
+			CompileAltFilter();
+		}
+		catch (...) {}
+	}
+	if (FunctionId == FUNCTION_ALT_FILT_BANDS) {
+		// written back tidied up, so a typo shows as the band it was read as
+		altFilterBands = FilterRules::BandsText(FilterRules::ParseBands(sItemString));
+		CompileAltFilter();
+	}
+	if (FunctionId == FUNCTION_ALT_FILT_VFR) {
+		try {
+			altFilterVfrFloor = max(0, stoi(sItemString));
+			CompileAltFilter();
+		}
+		catch (...) {}
+	}
+	if (FunctionId == FUNCTION_MAP_LAYER) {
+		if (!strcmp(sItemString, "Boundaries")) { mapLayers ^= 1 << VMAP_BOUNDARIES; }
+		if (!strcmp(sItemString, "Airways")) { mapLayers ^= 1 << VMAP_AIRWAYS; }
+		if (!strcmp(sItemString, "Geo")) { mapLayers ^= 1 << VMAP_GEO; }
+
+		SaveDataToAsr("situMap", "Video Map Layers", to_string(mapLayers).c_str());
+		RefreshMapContent();
+	}
+	if (FunctionId == FUNCTION_CJS_SECTOR) {
+		SituPlugin* plugin = static_cast<SituPlugin*>(GetPlugIn());
+		set<string> names = plugin->airspace.Selected();
+		if (!names.erase(sItemString)) {
+			names.insert(sItemString);
+		}
+		plugin->SelectAirspace(names);
+
+		string saved;
+		for (const string& n : names) {
+			saved += (saved.empty() ? "" : ",") + n;
+		}
+		SaveDataToAsr("cjsSectors", "CJS Sectors", saved.c_str());
+	}
+	if (FunctionId == FUNCTION_QUICK_LOOK) {
+		if (!strcmp(sItemString, "Clear")) {
+			quickLook.clear();
+		}
+		else if (!quickLook.erase(sItemString)) {
+			quickLook.insert(sItemString);
+		}
+	}
+	if (FunctionId == FUNCTION_CLUSTER_RANGE) {
+		try {
+			clusterRange = max(0, stoi(sItemString));
+			SaveDataToAsr("situClusterRange", "Target Clustering Range", to_string(clusterRange).c_str());
+		}
+		catch (...) {}
+	}
+
+	if (FunctionId == FUNCTION_CJS_LEAD) {
+		try {
+			cjsLead = max(0, stoi(sItemString));
+			SaveDataToAsr("cjsLead", "CJS Warning Lead Time", to_string(cjsLead).c_str());
+		}
+		catch (...) {}
+	}
+	if (FunctionId == FUNCTION_GND_AIRPORT) {
+		string icao = sItemString;
+		transform(icao.begin(), icao.end(), icao.begin(), ::toupper);
+		if (static_cast<SituPlugin*>(GetPlugIn())->airports.Find(icao) >= 0) {
+			gndAirport = icao;
+			SaveDataToAsr("gndAirport", "Ground Mode Aerodrome", gndAirport.c_str());
+		}
+	}
+	if (FunctionId == FUNCTION_CPA_RADIUS) {
+		try {
+			double rad = stod(sItemString);
+			if (rad > 0) {
+				cpaRadius = rad;
+
+				// the grid cells follow the search radius, so every target goes back in
+				targetGrid.SetCellSize(cpaRadius);
+				for (auto& td : static_cast<SituPlugin*>(GetPlugIn())->targets.Targets()) {
+					targetGrid.Update(td.first, td.second.pos);
+				}
+				MarkAllCPADirty();
+
+				SaveDataToAsr("cpaRadius", "CPA Search Radius", to_string((int)cpaRadius).c_str());
+			}
 		}
 		catch (...) {}
 	}
 }
 
-void CSiTRadar::ButtonToScreen(CSiTRadar* radscr, RECT rect, string btext, int itemtype) {
-	AddScreenObject(itemtype, btext.c_str(), rect, 0, "");
+void CSiTRadar::OnRadarTargetPositionUpdate(CRadarTarget RadarTarget) {
+	
+	// the kinematics live in the plugin's store, this screen only keeps what depends on its own settings
+	const TargetData& td = static_cast<SituPlugin*>(GetPlugIn())->targets.UpdatePosition(RadarTarget);
+
+	// the filtered track and speed are only ready once the store flushes, so the PTL waits for the next
+	// refresh; targets without a PTL are left alone and get an end point when one is turned on
+	if (ptlAll || hasPTL.find(RadarTarget.GetCallsign()) != hasPTL.end()) {
+		ptlDirty.insert(RadarTarget.GetCallsign());
+	}
+
+	targetGrid.Update(RadarTarget.GetCallsign(), td.pos);
+	if (cpaOn) {
+		cpaDirty.insert(RadarTarget.GetCallsign());
+	}
+
+	// move any RBL anchored to this target
+	for (auto& rbl : rbls) {
+		bool moved = FALSE;
+		if (rbl.a.callsign == RadarTarget.GetCallsign()) { rbl.a.pos = td.pos; moved = TRUE; }
+		if (rbl.b.callsign == RadarTarget.GetCallsign()) { rbl.b.pos = td.pos; moved = TRUE; }
+
+		if (moved) {
+			RBLTool::CalcRBL(rbl, magVar);
+		}
+	}
+
+	if (rblPending && rblCursor.a.callsign == RadarTarget.GetCallsign()) {
+		rblCursor.a.pos = td.pos;
+		RBLTool::CalcRBL(rblCursor, magVar);
+	}
+}
+
+void CSiTRadar::OnOverScreenObject(int ObjectType, const char* sObjectId, POINT Pt, RECT Area) {
+
+	// the pending RBL follows the cursor; only redraw when the cursor actually moved,
+	// rather than asking for a refresh every frame
+	if (rblPending && (Pt.x != rblCursorPt.x || Pt.y != rblCursorPt.y)) {
+		rblCursorPt = Pt;
+		rblCursor.b.pos = ConvertCoordFromPixelToPosition(Pt);
+		RBLTool::CalcRBL(rblCursor, magVar);
+
+		RequestRefresh();
+	}
+}
+
+void CSiTRadar::DropTarget(const string& callsign) {
+	for (CSiTRadar* radscr : openScreens) {
+		radscr->ForgetTarget(callsign);
+	}
+}
+
+void CSiTRadar::ForgetTarget(const string& callsign) {
+	ptlEnds.erase(callsign);
+	ptlDirty.erase(callsign);
+	tagPlacer.Remove(callsign);
+	tagLayouts.erase(callsign);
+	gndLayouts.erase(callsign);
+	targetGrid.Remove(callsign);
+	clusterGrid.Remove(callsign);
+	hasPTL.erase(callsign);
+	isHandOffHold.erase(callsign);
+	if (cpaOn) {
+		cpaDirty.insert(callsign); // no longer in the store, so its pairs are dropped
+	}
+
+	// RBLs anchored to the target go with it
+	for (auto rbl = rbls.begin(); rbl != rbls.end();) {
+		if (rbl->a.callsign == callsign || rbl->b.callsign == callsign) {
+			rbl = rbls.erase(rbl);
+		}
+		else {
+			rbl++;
+		}
+	}
+	if (rblPending && rblCursor.a.callsign == callsign) {
+		rblPending = FALSE;
+	}
+}
+
+void CSiTRadar::UpdateCPAs() {
+	const TargetStore& targets = static_cast<SituPlugin*>(GetPlugIn())->targets;
+
+	for (const string& callsign : cpaDirty) {
+
+		// drop the old pairs of this target, the ones still in range are redone below
+		auto partners = cpaPartners.find(callsign);
+		if (partners != cpaPartners.end()) {
+			for (const string& other : partners->second) {
+				cpaPairs.erase(CPATool::PairKey(callsign, other));
+				cpaPartners[other].erase(callsign);
+			}
+			cpaPartners.erase(partners);
+		}
+
+		const TargetData* td = targets.Find(callsign);
+		if (!cpaOn || td == nullptr) {
+			continue;
+		}
+
+		bool haloed = hashalo.find(callsign) != hashalo.end();
+		if (!cpaAll && !haloed) {
+			continue;
+		}
+
+		// only targets in the neighbouring grid cells can be in range
+		cpaNear.clear();
+		targetGrid.Query(td->pos, cpaRadius, cpaNear);
+
+		for (const string& other : cpaNear) {
+			if (other == callsign) {
+				continue;
+			}
+			if (!cpaAll && hashalo.find(other) == hashalo.end()) {
+				continue;
+			}
+
+			const TargetData* to = targets.Find(other);
+			if (to == nullptr || Geodesy::DistanceNM(td->pos, to->pos) > cpaRadius) {
+				continue;
+			}
+
+			cpaPairs[CPATool::PairKey(callsign, other)] = CPATool::CalcCPA(*td, *to);
+			cpaPartners[callsign].insert(other);
+			cpaPartners[other].insert(callsign);
+		}
+	}
+
+	cpaDirty.clear();
+}
+
+// the menu's altitude filter settings as filter rules; the low and high limits are the first band
+void CSiTRadar::CompileAltFilter() {
+	FilterRules rules;
+	rules.on = altFilterOn;
+	rules.bands.push_back({ altFilterLow, altFilterHigh });
+	for (const FilterBand& b : FilterRules::ParseBands(altFilterBands.c_str())) {
+		rules.bands.push_back(b);
+	}
+	rules.keep = altFilterKeep;
+	rules.vfrFloor = altFilterVfrFloor;
+	altFilter.Compile(rules);
+}
+
+void CSiTRadar::ClearHalos() {
+	for (auto& h : hashalo) {
+		static_cast<SituPlugin*>(GetPlugIn())->SetHalo(h.first, FALSE);
+	}
+	hashalo.clear();
+}
+
+// one shot timers for the smooth motion frames, by timer id; all on the UI thread
+static map<UINT_PTR, CSiTRadar*> xtrapTimers;
+
+void CSiTRadar::ScheduleXtrapFrame(int ms) {
+	if (xtrapTimer != 0) {
+		KillTimer(NULL, xtrapTimer);
+		xtrapTimers.erase(xtrapTimer);
+		xtrapTimer = 0;
+	}
+
+	// 0 just cancels the pending one
+	if (ms > 0) {
+		xtrapTimer = SetTimer(NULL, 0, ms, XtrapTimerProc);
+		if (xtrapTimer != 0) {
+			xtrapTimers[xtrapTimer] = this;
+		}
+	}
+}
+
+void CALLBACK CSiTRadar::XtrapTimerProc(HWND hwnd, UINT msg, UINT_PTR id, DWORD time) {
+	KillTimer(NULL, id);
+
+	auto it = xtrapTimers.find(id);
+	if (it != xtrapTimers.end()) {
+		CSiTRadar* radscr = it->second;
+		xtrapTimers.erase(it);
+		radscr->xtrapTimer = 0;
+		radscr->RequestRefresh();
+	}
+}
+
+void CSiTRadar::MarkAllCPADirty() {
+	cpaPairs.clear();
+	cpaPartners.clear();
+	cpaDirty.clear();
+
+	if (cpaOn) {
+		for (auto& td : static_cast<SituPlugin*>(GetPlugIn())->targets.Targets()) {
+			cpaDirty.insert(td.first);
+		}
+	}
+}
+
+void CSiTRadar::ButtonToScreen(CSiTRadar* radscr, RECT rect, const char* btext, int itemtype) {
+	AddScreenObject(itemtype, btext, rect, 0, "");
 }
 
 void CSiTRadar::OnAsrContentLoaded(bool Loaded) {
@@ -714,6 +1871,114 @@ void CSiTRadar::OnAsrContentLoaded(bool Loaded) {
 	if ((filt = GetDataFromAsr("altFilterLow")) != NULL) {
 		altFilterLow = atoi(filt);
 	}
+	if ((filt = GetDataFromAsr("altFilterBands")) != NULL) {
+		altFilterBands = FilterRules::BandsText(FilterRules::ParseBands(filt));
+	}
+	if ((filt = GetDataFromAsr("altFilterVfrFloor")) != NULL) {
+		altFilterVfrFloor = max(0, atoi(filt));
+	}
+	if ((filt = GetDataFromAsr("altFilterKeep")) != NULL) {
+		altFilterKeep = atoi(filt);
+	}
+	CompileAltFilter();
+
+	// range rings
+	if ((filt = GetDataFromAsr("ringSpacing")) != NULL) {
+		for (int idx = 0; idx < 9; idx++) {
+			if (ringoptions[idx] == filt) {
+				ringidx = idx;
+				ringSpacing = stod(ringoptions[idx]);
+			}
+		}
+	}
+	if ((filt = GetDataFromAsr("ringLat")) != NULL) {
+		ringCentre.m_Latitude = atof(filt);
+		if ((filt = GetDataFromAsr("ringLon")) != NULL) {
+			ringCentre.m_Longitude = atof(filt);
+			ringCentreSet = TRUE;
+		}
+	}
+
+	// cpa search radius
+	if ((filt = GetDataFromAsr("cpaRadius")) != NULL) {
+		if (atof(filt) > 0) {
+			cpaRadius = atof(filt);
+			targetGrid.SetCellSize(cpaRadius);
+		}
+	}
+
+	// aerodromes come from the sector file, which is loaded by now; the ASR may bring a
+	// different sector file with it, so it's looked at again on every load
+	SituPlugin* situ = static_cast<SituPlugin*>(GetPlugIn());
+	if (!situ->airports.Loaded() || situ->sectorFile != situ->ControllerMyself().GetSectorFileName()) {
+		situ->LoadSectorData();
+	}
+
+	// our airspace for the CJS warnings, shared by the plugin so the last ASR loaded wins
+	if ((filt = GetDataFromAsr("cjsSectors")) != NULL) {
+		set<string> names;
+		string token;
+		istringstream list(filt);
+		while (getline(list, token, ',')) {
+			if (!token.empty()) {
+				names.insert(token);
+			}
+		}
+		static_cast<SituPlugin*>(GetPlugIn())->SelectAirspace(names);
+	}
+	if ((filt = GetDataFromAsr("cjsLead")) != NULL) {
+		cjsLead = atoi(filt);
+	}
+
+	if ((filt = GetDataFromAsr("gndAirport")) != NULL) {
+		gndAirport = filt;
+	}
+
+	if ((filt = GetDataFromAsr("situHist")) != NULL) {
+		for (int i = 0; i < 4; i++) {
+			if (histoptions[i] == filt) {
+				histidx = i;
+				trailLen = stoi(histoptions[i]);
+			}
+		}
+	}
+
+	if ((filt = GetDataFromAsr("situMap")) != NULL) {
+		mapLayers = atoi(filt);
+	}
+
+	if ((filt = GetDataFromAsr("situXtrap")) != NULL) {
+		xtrapOn = atoi(filt) != 0;
+	}
+
+	if ((filt = GetDataFromAsr("situStats")) != NULL) {
+		statsOn = atoi(filt) != 0;
+	}
+
+	if ((filt = GetDataFromAsr("situCluster")) != NULL) {
+		clusterOn = atoi(filt) != 0;
+	}
+	if ((filt = GetDataFromAsr("situDensity")) != NULL) {
+		densityOn = atoi(filt) != 0;
+	}
+	if ((filt = GetDataFromAsr("situClusterRange")) != NULL) {
+		clusterRange = atoi(filt);
+	}
+
+	// plugin data tags
+	if ((filt = GetDataFromAsr("situTags")) != NULL) {
+		tagsOn = atoi(filt) != 0;
+	}
+
+	// PTL length, stored as one of the ptloptions
+	if ((filt = GetDataFromAsr("ptlLength")) != NULL) {
+		for (int idx = 0; idx < 9; idx++) {
+			if (ptloptions[idx] == filt) {
+				ptlidx = idx;
+				ptlLen = stod(ptloptions[idx]);
+			}
+		}
+	}
 }
 
 void CSiTRadar::OnAsrContentToBeSaved() {
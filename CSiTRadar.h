@@ -8,10 +8,27 @@
 #include <regex>
 #include <gdiplus.h>
 #include "pch.h"
+#include "TargetStore.h"
+#include "RBLTool.h"
+#include "RingsGrid.h"
+#include "VideoMap.h"
+#include "CPATool.h"
+#include "tagRender.h"
+#include "TagPlacer.h"
+#include "GndRadar.h"
+#include "SpatialHash.h"
+#include "FrameBudget.h"
+#include "DrawOrder.h"
+#include "ClusterTool.h"
+#include "TargetFilter.h"
+#include <set>
 
 using namespace EuroScopePlugIn;
 using namespace std;
 
+// smooth motion never asks for more frames than this a second
+const int XTRAP_MAX_FPS = 10;
+
 class CSiTRadar :
     public EuroScopePlugIn::CRadarScreen
 
@@ -38,6 +55,13 @@ public:
 
     void OnFunctionCall(int FunctionId, const char* sItemString, POINT Pt, RECT Area);
 
+    void OnOverScreenObject(int ObjectType, const char* sObjectId, POINT Pt, RECT Area);
+
+    void OnRadarTargetPositionUpdate(CRadarTarget RadarTarget);
+
+    // the plugin dropped the target; cleans it up on every open screen
+    static void DropTarget(const string& callsign);
+
     double RadRange(void)
     {
         RECT radarea = GetRadarArea();
@@ -83,19 +107,48 @@ public:
         SaveDataToAsr("tagfamily", "Tag Family", sv);
         */
 
+        ClearHalos();
+
         delete this;
     };
 
 protected:
-    void ButtonToScreen(CSiTRadar* radscr, RECT rect, string btext, int itemtype);
+    void ButtonToScreen(CSiTRadar* radscr, RECT rect, const char* btext, int itemtype);
 
     // helper functions
+    void UpdateCPAs();
+    void MarkAllCPADirty();
+    void ClearHalos();
+    void ForgetTarget(const string& callsign);
+    void CompileAltFilter();
+    void ScheduleXtrapFrame(int ms);
+    static void CALLBACK XtrapTimerProc(HWND hwnd, UINT msg, UINT_PTR id, DWORD time);
 
     // menu states
     bool halotool = FALSE;
     bool mousehalo = FALSE;
     bool altFilterOpts = FALSE;
     bool altFilterOn = TRUE;
+    bool ptltool = FALSE;
+    bool ptlAll = FALSE;
+    bool rbltool = FALSE;
+    bool rblPending = FALSE; // first end placed, line follows the cursor
+    bool ringsOn = FALSE;
+    bool ringsMenu = FALSE;
+    bool ringCentrePick = FALSE; // next map click sets the ring centre
+    bool ringCentreSet = FALSE;
+    bool gridOn = FALSE;
+    bool cpaOn = FALSE;
+    bool cpaAll = FALSE; // every pair in range, not just haloed pairs
+    bool tagsOn = FALSE; // plugin drawn data blocks
+    bool gndMode = FALSE;
+    int mapLayers = 0; // plugin video map layers shown, bit per VMAP_ layer
+    bool xtrapOn = FALSE; // PPS moved on from the filtered track between radar updates
+    UINT_PTR xtrapTimer = 0; // pending request for the next smooth motion frame
+    bool statsOn = FALSE;
+    bool clusterOn = FALSE;
+    bool densityOn = FALSE; // heatmap rather than counts when clustered
+    set<string> quickLook; // positions whose targets get full data and ignore the altitude filter
 
     bool pressed = FALSE;
     int haloidx = 1; // default halo radius = 3, corresponds to index of the halooptions
@@ -104,19 +157,92 @@ protected:
     bool halfSecTick; // toggles on and off every half second
 
     map<string, bool> hashalo;
-    map<string, bool> isBlinking;
+    int cjsLead = 2; // minutes of warning before entering or leaving the selected sectors
     map<string, bool> isHandOffHold;
+    map<string, bool> hasPTL;
+
+    // PTL end points at this screen's PTL length; everything else about a target is in the plugin's store
+    map<string, CPosition> ptlEnds;
+    set<string> ptlDirty;
+
+    // range bearing lines; the pending one runs from its first anchor to the cursor
+    vector<RBL> rbls;
+    RBL rblCursor;
+    POINT rblCursorPt = { 0, 0 };
+    double magVar = 0;
+    bool magVarSet = FALSE;
+
+    // targets bucketed by position for the pair searches
+    SpatialHash<string> targetGrid;
+
+    // the targets counted into the clusters at wide ranges
+    ClusterGrid clusterGrid;
+
+    // cpa of each pair in range, only recalculated when one of the pair updates
+    map<pair<string, string>, CPAResult> cpaPairs;
+    map<string, set<string>> cpaPartners;
+    set<string> cpaDirty;
+    vector<string> cpaNear; // grid query results, kept so the refresh doesn't allocate them
+
+    // laid out data blocks, only redone when the target's data changes
+    TagLayoutCache tagLayouts;
+    TagPlacer tagPlacer;
+
+    // ground mode tags and the GDI objects they are drawn with
+    TagLayoutCache gndLayouts;
+    GndTagStyle gndStyle;
+
+    // what the after tags refresh costs, and how much of it is given up when over budget
+    FrameBudget frameBudget;
+    DrawOrder drawOrder;
+    TargetFilter altFilter; // compiled from the settings below whenever they change
+
+    // range rings and grid, rebuilt only when the viewport changes
+    RingsGridCache ringsGridCache;
+    VideoMapCache videoMapCache;
+    CPosition ringCentre;
 
     // menu functions
     RECT rLLim = { 0, 0, 10, 10 };
     RECT rHLim = { 0, 0, 10, 10 };
+    RECT rBands = { 0, 0, 10, 10 };
+    RECT rVfrFloor = { 0, 0, 10, 10 };
 
     // menu settings
     int altFilterLow = 0;
     int altFilterHigh = 0; 
+    string altFilterBands; // bands shown besides the low to high limit, "250-600,..."
+    int altFilterVfrFloor = 0; // FL, 0 is off
+    int altFilterKeep = 0;
 
     double halorad = 3;
     string halooptions[9] = { "0.5", "3", "5", "10", "15", "20", "30", "60", "80" };
+
+    double ptlLen = 3; // PTL length in minutes
+    int ptlidx = 2; // default PTL length = 3, corresponds to index of the ptloptions
+    string ptloptions[9] = { "1", "2", "3", "4", "5", "6", "8", "10", "15" };
+
+    double cpaRadius = 20; // NM, pairs further apart than this are not checked
+    double cpaMaxTime = 20; // minutes, cpas further ahead are not shown
+
+    string gndAirport;
+    int gndMaxGs = 50; // kts
+    int gndMaxAlt = 5000; // ft, pressure altitude
+    RECT rGndAirport = { 0, 0, 10, 10 };
+
+    int clusterRange = 400; // NM across the radar area above which targets are clustered
+    RECT rCluster = { 0, 0, 10, 10 };
+
+    int leaderLen = 10; // px
+    int tagAngle = 30; // degrees clockwise from north
+
+    double ringSpacing = 20; // NM
+    int ringidx = 3;
+    string ringoptions[9] = { "5", "10", "15", "20", "25", "30", "40", "50", "100" };
+
+    int trailLen = 0; // history dots drawn behind each PPS
+    int histidx = 0;
+    string histoptions[4] = { "0", "3", "5", "10" };
     string controllerID;
     string radtype;
 };
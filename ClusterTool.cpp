@@ -0,0 +1,79 @@
+#include "pch.h"
+#include "ClusterTool.h"
+#include <unordered_map>
+
+ClusterTool::ClusterTool()
+{
+}
+
+ClusterTool::~ClusterTool()
+{
+}
+
+const vector<Cluster>& ClusterTool::Aggregate(CRadarScreen* radscr, ClusterGrid& cg)
+{
+	RECT area = radscr->GetRadarArea();
+	CPosition ll, ur;
+	radscr->GetDisplayArea(&ll, &ur);
+
+	vector<Cluster>& out = cg.clusters;
+	if (cg.builtVersion == cg.version && EqualRect(&cg.builtArea, &area)
+		&& ll.m_Latitude == cg.builtLL.m_Latitude && ll.m_Longitude == cg.builtLL.m_Longitude
+		&& ur.m_Latitude == cg.builtUR.m_Latitude && ur.m_Longitude == cg.builtUR.m_Longitude) {
+		return out;
+	}
+	cg.builtVersion = cg.version;
+	cg.builtArea = area;
+	cg.builtLL = ll;
+	cg.builtUR = ur;
+	out.clear();
+
+	const SpatialHash<string>& grid = cg.grid;
+
+	// screen cell, index in out; the x and y sums are kept alongside until the end
+	unordered_map<long long, size_t, hash<long long>, equal_to<long long>, FrameAllocator<pair<const long long, size_t>>> cellIdx;
+	FrameVector<long long> sumX, sumY;
+
+	for (auto& cell : grid.Cells()) {
+		int n = (int)cell.second.size();
+		POINT p = radscr->ConvertCoordFromPositionToPixel(grid.Centre(cell.first));
+		if (p.x < area.left || p.x >= area.right || p.y < area.top || p.y >= area.bottom) {
+			continue;
+		}
+
+		int cx = (p.x - area.left) / CLUSTER_CELL_PX;
+		int cy = (p.y - area.top) / CLUSTER_CELL_PX;
+		long long key = SpatialHash<string>::Pack(cy, cx);
+
+		auto it = cellIdx.find(key);
+		size_t i;
+		if (it == cellIdx.end()) {
+			i = out.size();
+			cellIdx[key] = i;
+
+			Cluster c;
+			c.cell.left = area.left + cx * CLUSTER_CELL_PX;
+			c.cell.top = area.top + cy * CLUSTER_CELL_PX;
+			c.cell.right = c.cell.left + CLUSTER_CELL_PX;
+			c.cell.bottom = c.cell.top + CLUSTER_CELL_PX;
+			c.count = 0;
+			out.push_back(c);
+			sumX.push_back(0);
+			sumY.push_back(0);
+		}
+		else {
+			i = it->second;
+		}
+
+		out[i].count += n;
+		sumX[i] += (long long)p.x * n;
+		sumY[i] += (long long)p.y * n;
+	}
+
+	for (size_t i = 0; i < out.size(); i++) {
+		out[i].p.x = (LONG)(sumX[i] / out[i].count);
+		out[i].p.y = (LONG)(sumY[i] / out[i].count);
+	}
+
+	return out;
+}
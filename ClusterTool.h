@@ -0,0 +1,173 @@
+#pragma once
+#include "EuroScopePlugIn.h"
+#include "SpatialHash.h"
+#include "FrameArena.h"
+#include <vector>
+#include <string>
+#include <unordered_map>
+
+using namespace std;
+using namespace EuroScopePlugIn;
+
+// screen cells targets are gathered into, px
+const int CLUSTER_CELL_PX = 40;
+
+// heatmap shades, from the fewest targets in a cell to the most
+const int CLUSTER_SHADES = 4;
+
+// cells the counted targets are kept in, NM; several go into each screen cell at clustering ranges
+const double CLUSTER_CELL_NM = 5;
+
+struct Cluster {
+    POINT p; // middle of the targets in it, weighted by count
+    RECT cell;
+    int count;
+};
+
+// The targets that go into the clusters: shown by the altitude filter and not drawn on
+// their own. Targets are only moved between cells, or in and out, when that changes, and
+// the screen clusters are only gathered again when the grid or the view has changed
+class ClusterGrid
+{
+public:
+    ClusterGrid() : grid(CLUSTER_CELL_NM) {};
+
+    // each frame: BeginFrame, Set for every radar target, then Evict drops the ones that
+    // weren't set, i.e. targets ES no longer has however they went
+    void BeginFrame()
+    {
+        frame++;
+    };
+
+    void Set(const string& id, CPosition pos, bool counted)
+    {
+        if (counted ? grid.Update(id, pos) : grid.Remove(id)) {
+            version++;
+        }
+        if (counted) {
+            stamps[id] = frame;
+        }
+        else {
+            stamps.erase(id);
+        }
+    };
+
+    void Evict()
+    {
+        for (auto it = stamps.begin(); it != stamps.end();) {
+            if (it->second != frame) {
+                grid.Remove(it->first);
+                version++;
+                it = stamps.erase(it);
+            }
+            else {
+                it++;
+            }
+        }
+    };
+
+    void Remove(const string& id)
+    {
+        stamps.erase(id);
+        if (grid.Remove(id)) {
+            version++;
+        }
+    };
+
+protected:
+    friend class ClusterTool;
+
+    SpatialHash<string> grid;
+    unordered_map<string, unsigned int> stamps; // frame each counted target was last set in
+    unsigned int frame = 0;
+    unsigned int version = 1;
+
+    // what the clusters were last gathered from
+    vector<Cluster> clusters;
+    unsigned int builtVersion = 0;
+    CPosition builtLL, builtUR;
+    RECT builtArea = { 0, 0, 0, 0 };
+};
+
+class ClusterTool :
+    public CRadarScreen
+{
+public:
+    ClusterTool(void);
+    ~ClusterTool(void);
+
+    // Gathers the cluster grid's cells into CLUSTER_CELL_PX screen cells. Each grid cell
+    // counts as its size at its middle, so the work is per occupied grid cell rather than
+    // per target, and it is only redone when the grid or the view changed
+    static const vector<Cluster>& Aggregate(CRadarScreen* radscr, ClusterGrid& grid);
+
+    // a ring sized by the count with the count in it
+    static void DrawClusters(HDC hdc, const vector<Cluster>& clusters)
+    {
+        if (clusters.empty()) {
+            return;
+        }
+
+        CDC dc;
+        dc.Attach(hdc);
+
+        CFont font;
+        LOGFONT lgfont;
+
+        memset(&lgfont, 0, sizeof(LOGFONT));
+        lgfont.lfWeight = 500;
+        strcpy_s(lgfont.lfFaceName, _T("EuroScope"));
+        lgfont.lfHeight = 12;
+        font.CreateFontIndirect(&lgfont);
+        dc.SelectObject(font);
+
+        HPEN amberPen = CreatePen(PS_SOLID, 1, RGB(202, 205, 169));
+        dc.SelectObject(amberPen);
+        dc.SelectStockObject(NULL_BRUSH);
+        dc.SetTextColor(RGB(202, 205, 169));
+
+        for (const Cluster& c : clusters) {
+            int r = c.count < 5 ? 7 : c.count < 20 ? 10 : 13;
+            dc.Ellipse(c.p.x - r, c.p.y - r, c.p.x + r + 1, c.p.y + r + 1);
+
+            InlineString<8> n;
+            n.Append(c.count);
+            RECT rText = { c.p.x - r, c.p.y - 6, c.p.x + r + 1, c.p.y + 7 };
+            dc.DrawText(n.c_str(), &rText, DT_CENTER | DT_SINGLELINE | DT_NOCLIP);
+        }
+
+        DeleteObject(amberPen);
+        DeleteObject(font);
+        dc.Detach();
+    };
+
+    // the screen cells filled darker to brighter with the share of the busiest cell
+    static void DrawDensity(HDC hdc, const vector<Cluster>& clusters)
+    {
+        static const COLORREF shades[CLUSTER_SHADES] = {
+            RGB(45, 55, 60), RGB(80, 80, 65), RGB(140, 120, 70), RGB(242, 120, 57)
+        };
+
+        int most = 0;
+        for (const Cluster& c : clusters) {
+            most = max(most, c.count);
+        }
+        if (most == 0) {
+            return;
+        }
+
+        HBRUSH brushes[CLUSTER_SHADES];
+        for (int i = 0; i < CLUSTER_SHADES; i++) {
+            brushes[i] = CreateSolidBrush(shades[i]);
+        }
+
+        for (const Cluster& c : clusters) {
+            int shade = min(c.count * CLUSTER_SHADES / (most + 1), CLUSTER_SHADES - 1);
+            FillRect(hdc, &c.cell, brushes[shade]);
+        }
+
+        for (int i = 0; i < CLUSTER_SHADES; i++) {
+            DeleteObject(brushes[i]);
+        }
+    };
+};
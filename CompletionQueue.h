@@ -0,0 +1,70 @@
+#pragma once
+#include <atomic>
+#include <functional>
+
+using namespace std;
+
+// Lock free multi producer, single consumer queue of callbacks. Background tasks
+// post their results here from any thread; the UI thread drains it and runs the
+// callbacks, which is the only place a result can touch plugin or SDK state.
+class CompletionQueue
+{
+public:
+    CompletionQueue(void) : head(nullptr) {};
+    ~CompletionQueue(void) { Clear(); };
+
+    // any thread
+    void Post(function<void()> fn)
+    {
+        Node* n = new Node;
+        n->fn = move(fn);
+        n->next = head.load(memory_order_relaxed);
+
+        while (!head.compare_exchange_weak(n->next, n, memory_order_release, memory_order_relaxed)) {
+        }
+    };
+
+    // UI thread: run everything posted so far, oldest first
+    void Drain()
+    {
+        Node* n = Reverse(head.exchange(nullptr, memory_order_acquire));
+        while (n != nullptr) {
+            Node* next = n->next;
+            n->fn();
+            delete n;
+            n = next;
+        }
+    };
+
+    // drop everything without running it
+    void Clear()
+    {
+        Node* n = head.exchange(nullptr, memory_order_acquire);
+        while (n != nullptr) {
+            Node* next = n->next;
+            delete n;
+            n = next;
+        }
+    };
+
+protected:
+    struct Node {
+        function<void()> fn;
+        Node* next = nullptr;
+    };
+
+    // producers push onto the front, so the list comes out newest first
+    static Node* Reverse(Node* n)
+    {
+        Node* fifo = nullptr;
+        while (n != nullptr) {
+            Node* next = n->next;
+            n->next = fifo;
+            fifo = n;
+            n = next;
+        }
+        return fifo;
+    };
+
+    atomic<Node*> head;
+};
@@ -0,0 +1,65 @@
+#pragma once
+#include "EuroScopePlugIn.h"
+#include <vector>
+
+using namespace std;
+using namespace EuroScopePlugIn;
+
+// draw priority of a target, lowest drawn first so the most important end up on top
+const int PRIO_OTHER = 0;
+const int PRIO_HALOED = 1;
+const int PRIO_HANDOFF = 2; // being handed to or from us
+const int PRIO_OWNED = 3;
+const int PRIO_EMERGENCY = 4;
+const int PRIO_CLASSES = 5;
+
+struct DrawItem {
+    CRadarTarget target;
+    int prio;
+    int index; // order it was added in, for the frame's per target arrays
+};
+
+// The frame's radar targets sorted by priority class. A counting sort, so it is one
+// pass to count and one to place however many targets there are; inside a class the
+// SDK's order is kept. Kept between frames so the vectors are only grown, not rebuilt
+class DrawOrder
+{
+public:
+    void Clear()
+    {
+        items.clear();
+    };
+
+    void Add(CRadarTarget target, int prio)
+    {
+        items.push_back({ target, prio, (int)items.size() });
+    };
+
+    // in the order they were added
+    const vector<DrawItem>& Items() const { return items; };
+
+    const vector<DrawItem>& Sorted()
+    {
+        int start[PRIO_CLASSES] = { 0 };
+        for (const DrawItem& it : items) {
+            start[it.prio]++;
+        }
+
+        int at = 0;
+        for (int c = 0; c < PRIO_CLASSES; c++) {
+            int n = start[c];
+            start[c] = at;
+            at += n;
+        }
+
+        sorted.resize(items.size());
+        for (const DrawItem& it : items) {
+            sorted[start[it.prio]++] = it;
+        }
+        return sorted;
+    };
+
+protected:
+    vector<DrawItem> items;
+    vector<DrawItem> sorted;
+};
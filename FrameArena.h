@@ -0,0 +1,206 @@
+#pragma once
+#include <vector>
+#include <memory>
+#include <charconv>
+#include <cstring>
+#include <cstdio>
+#include <cstddef>
+#include <algorithm>
+
+using namespace std;
+
+// arena blocks, bytes; anything bigger gets a block of its own
+const size_t FRAME_BLOCK_SIZE = 64 * 1024;
+
+// Bump allocator for everything a refresh builds and throws away. Memory is handed out
+// from big blocks and never freed one piece at a time; Reset at the end of OnRefresh
+// rewinds to the first block, and the blocks are kept, so once a frame has grown them
+// the next ones allocate nothing. UI thread only, like the drawing
+class FrameArena
+{
+public:
+    ~FrameArena()
+    {
+        for (Block& b : blocks) {
+            ::operator delete(b.data);
+        }
+    };
+
+    // the arena of the drawing thread
+    static FrameArena& Frame()
+    {
+        static FrameArena arena;
+        return arena;
+    };
+
+    void* Allocate(size_t bytes, size_t align)
+    {
+        while (current < blocks.size()) {
+            Block& b = blocks[current];
+            size_t at = (used + align - 1) & ~(align - 1);
+            if (at + bytes <= b.size) {
+                used = at + bytes;
+                return b.data + at;
+            }
+            current++;
+            used = 0;
+        }
+
+        Block b;
+        b.size = bytes > FRAME_BLOCK_SIZE ? bytes : FRAME_BLOCK_SIZE;
+        b.data = (char*)::operator new(b.size);
+        blocks.push_back(b);
+        current = blocks.size() - 1;
+        used = bytes;
+        return b.data;
+    };
+
+    void Reset()
+    {
+        current = 0;
+        used = 0;
+    };
+
+protected:
+    struct Block {
+        char* data;
+        size_t size;
+    };
+
+    vector<Block> blocks;
+    size_t current = 0;
+    size_t used = 0;
+};
+
+// standard allocator over the frame arena, so the per frame vectors can live in it
+template <typename T>
+struct FrameAllocator {
+    typedef T value_type;
+
+    FrameAllocator() {}
+    template <typename U> FrameAllocator(const FrameAllocator<U>&) {}
+
+    T* allocate(size_t n)
+    {
+        return (T*)FrameArena::Frame().Allocate(n * sizeof(T), alignof(T));
+    };
+
+    void deallocate(T*, size_t) {}; // given back when the frame is reset
+
+    template <typename U> bool operator==(const FrameAllocator<U>&) const { return true; }
+    template <typename U> bool operator!=(const FrameAllocator<U>&) const { return false; }
+};
+
+// a vector that is only good until the end of the refresh it was made in
+template <typename T>
+using FrameVector = vector<T, FrameAllocator<T>>;
+
+// Fixed capacity text built in place, for labels put together every frame. Anything
+// past the capacity is cut off rather than allocated
+template <size_t N>
+class InlineString
+{
+public:
+    InlineString() { buf[0] = '\0'; };
+    InlineString(const char* s) { buf[0] = '\0'; Append(s); };
+
+    InlineString& Append(const char* s)
+    {
+        size_t n = min(strlen(s), N - 1 - len);
+        memcpy(buf + len, s, n);
+        len += n;
+        buf[len] = '\0';
+        return *this;
+    };
+
+    InlineString& Append(char c)
+    {
+        if (len + 1 < N) {
+            buf[len++] = c;
+            buf[len] = '\0';
+        }
+        return *this;
+    };
+
+    InlineString& Append(int v)
+    {
+        auto res = to_chars(buf + len, buf + N - 1, v);
+        if (res.ec == errc()) {
+            len = res.ptr - buf;
+        }
+        buf[len] = '\0';
+        return *this;
+    };
+
+    // fixed point, places digits after the point
+    InlineString& Append(double v, int places)
+    {
+        auto res = to_chars(buf + len, buf + N - 1, v, chars_format::fixed, places);
+        if (res.ec == errc()) {
+            len = res.ptr - buf;
+        }
+        buf[len] = '\0';
+        return *this;
+    };
+
+    // keeps the first n characters
+    void Truncate(size_t n)
+    {
+        if (n < len) {
+            len = n;
+            buf[len] = '\0';
+        }
+    };
+
+    const char* c_str() const { return buf; };
+    size_t size() const { return len; };
+    bool empty() const { return len == 0; };
+    void clear() { len = 0; buf[0] = '\0'; };
+
+protected:
+    char buf[N];
+    size_t len = 0;
+};
+
+#ifdef _DEBUG
+#include <crtdbg.h>
+
+// Debug builds count the CRT heap allocations the drawing thread makes between Begin
+// and End, shown in the stats line. A diagnostic only, nothing is asserted: frames where
+// a target first appears, moves into a grid cell nobody used before or the screen's
+// caches grow still allocate, and that is expected
+class FrameAllocCounter
+{
+public:
+    static void Begin()
+    {
+        static bool hooked = false;
+        if (!hooked) {
+            _CrtSetAllocHook(Hook);
+            hooked = true;
+        }
+        thread() = GetCurrentThreadId();
+        count() = 0;
+        counting() = true;
+    };
+
+    static int End()
+    {
+        counting() = false;
+        return count();
+    };
+
+protected:
+    static int __cdecl Hook(int allocType, void*, size_t, int, long, const unsigned char*, int)
+    {
+        if (counting() && allocType != _HOOK_FREE && GetCurrentThreadId() == thread()) {
+            count()++;
+        }
+        return TRUE;
+    };
+
+    static DWORD& thread() { static DWORD t = 0; return t; };
+    static int& count() { static int c = 0; return c; };
+    static bool& counting() { static bool b = false; return b; };
+};
+#endif
@@ -0,0 +1,102 @@
+#pragma once
+#include "FrameArena.h"
+#include <chrono>
+#include <cstdio>
+
+using namespace std;
+
+// parts of the after tags refresh that are timed
+const int STAGE_TARGETS = 0; // the radar target loop
+const int STAGE_TAGS = 1; // history dots, runways, ground and data tags
+const int STAGE_OVERLAYS = 2; // PTLs, CPAs, RBLs and flight plan tracks
+const int STAGE_MENU = 3;
+const int FRAME_STAGES = 4;
+
+const double FRAME_BUDGET_MS = 8;
+
+// what is given up when over budget, in order; each level also drops everything the
+// ones before it did. Emergencies and our own targets are always drawn in full
+const int DEGRADE_NONE = 0;
+const int DEGRADE_CJS = 1; // no CJS text for targets off the radar area
+const int DEGRADE_HALOS = 2; // no halos outside the focus area
+const int DEGRADE_TRAILS = 3; // history dots cut to DEGRADE_TRAIL_LEN
+const int DEGRADE_LEVELS = 4;
+const int DEGRADE_TRAIL_LEN = 1;
+
+// frames in a row over budget, or under half of it, before the level moves one step
+const int BUDGET_FRAMES = 5;
+
+// Times each stage of a frame, and steps the degradation level up while frames run
+// over FRAME_BUDGET_MS and back down once there is room again. Half the budget is the
+// way back so a level isn't dropped and taken again every few frames
+class FrameBudget
+{
+public:
+    void Begin()
+    {
+        start = last = chrono::steady_clock::now();
+    };
+
+    void Mark(int stage)
+    {
+        auto now = chrono::steady_clock::now();
+        stageMs[stage] = chrono::duration<double, milli>(now - last).count();
+        last = now;
+    };
+
+    void End()
+    {
+        frameMs = chrono::duration<double, milli>(last - start).count();
+
+        if (frameMs > FRAME_BUDGET_MS) {
+            under = 0;
+            if (++over >= BUDGET_FRAMES && level < DEGRADE_LEVELS - 1) {
+                level++;
+                over = 0;
+            }
+        }
+        else if (frameMs < FRAME_BUDGET_MS / 2) {
+            over = 0;
+            if (++under >= BUDGET_FRAMES && level > DEGRADE_NONE) {
+                level--;
+                under = 0;
+            }
+        }
+        else {
+            over = 0;
+            under = 0;
+        }
+    };
+
+    int Level() const { return level; };
+    bool Drops(int what) const { return level >= what; };
+
+    // debug builds: heap allocations the last frame made, for the stats line
+    void SetHeapAllocs(int n) { heapAllocs = n; };
+
+    // one line for the screen, e.g. "frame 6.1 ms (tgt 3.2 tag 1.5 ovl 0.9 menu 0.5) lod 1 cjs"
+    InlineString<160> StatsLine() const
+    {
+        static const char* levelNames[DEGRADE_LEVELS] = { "full", "cjs", "halos", "trails" };
+
+        char buf[160];
+        int n = sprintf_s(buf, "frame %.1f ms (tgt %.1f tag %.1f ovl %.1f menu %.1f) lod %d %s",
+            frameMs, stageMs[STAGE_TARGETS], stageMs[STAGE_TAGS], stageMs[STAGE_OVERLAYS], stageMs[STAGE_MENU],
+            level, levelNames[level]);
+        if (heapAllocs >= 0 && n > 0) {
+            sprintf_s(buf + n, sizeof(buf) - n, " heap %d", heapAllocs);
+        }
+        return InlineString<160>(buf);
+    };
+
+protected:
+    chrono::steady_clock::time_point start;
+    chrono::steady_clock::time_point last;
+    double stageMs[FRAME_STAGES] = { 0, 0, 0, 0 };
+    double frameMs = 0;
+
+    int heapAllocs = -1; // not counted in release builds
+    int level = DEGRADE_NONE;
+    int over = 0;
+    int under = 0;
+};
@@ -0,0 +1,73 @@
+#pragma once
+#include "EuroScopePlugIn.h"
+#include <cmath>
+
+using namespace EuroScopePlugIn;
+
+const double PI = 3.14159265358979323846;
+const double EARTH_RADIUS_NM = 3440.065;
+
+// Plugin side earth maths on a spherical earth, distances in nautical miles and
+// bearings in degrees true. Keeps per frame code away from the SDK geodesy calls.
+class Geodesy
+{
+public:
+    static double ToRad(double deg) { return deg * PI / 180.0; }
+    static double ToDeg(double rad) { return rad * 180.0 / PI; }
+
+    // great circle distance in NM
+    static double DistanceNM(CPosition from, CPosition to)
+    {
+        double lat1 = ToRad(from.m_Latitude);
+        double lat2 = ToRad(to.m_Latitude);
+        double dlat = lat2 - lat1;
+        double dlon = ToRad(to.m_Longitude - from.m_Longitude);
+
+        double a = sin(dlat / 2) * sin(dlat / 2) + cos(lat1) * cos(lat2) * sin(dlon / 2) * sin(dlon / 2);
+
+        return 2 * EARTH_RADIUS_NM * atan2(sqrt(a), sqrt(1 - a));
+    };
+
+    // initial true bearing from one position to another, 0 - 360
+    static double BearingTrue(CPosition from, CPosition to)
+    {
+        double lat1 = ToRad(from.m_Latitude);
+        double lat2 = ToRad(to.m_Latitude);
+        double dlon = ToRad(to.m_Longitude - from.m_Longitude);
+
+        double brg = ToDeg(atan2(sin(dlon) * cos(lat2), cos(lat1) * sin(lat2) - sin(lat1) * cos(lat2) * cos(dlon)));
+
+        return fmod(brg + 360.0, 360.0);
+    };
+
+    // magnetic variation of the active sector file around a position (east negative,
+    // so magnetic = true + magvar). Costs one SDK DirectionTo call, so call it once and keep the result
+    static double MagVar(CPosition pos)
+    {
+        CPosition ref = DestinationPoint(pos, 0, 10);
+
+        double var = pos.DirectionTo(ref) - BearingTrue(pos, ref);
+        if (var > 180) { var -= 360; }
+        if (var < -180) { var += 360; }
+
+        return var;
+    };
+
+    // position reached from "from" after travelling dist NM along a true bearing
+    static CPosition DestinationPoint(CPosition from, double brgTrue, double dist)
+    {
+        double lat1 = ToRad(from.m_Latitude);
+        double lon1 = ToRad(from.m_Longitude);
+        double brg = ToRad(brgTrue);
+        double d = dist / EARTH_RADIUS_NM;
+
+        double lat2 = asin(sin(lat1) * cos(d) + cos(lat1) * sin(d) * cos(brg));
+        double lon2 = lon1 + atan2(sin(brg) * sin(d) * cos(lat1), cos(d) - sin(lat1) * sin(lat2));
+
+        CPosition to;
+        to.m_Latitude = ToDeg(lat2);
+        to.m_Longitude = ToDeg(lon2);
+
+        return to;
+    };
+};
@@ -1,66 +1,123 @@
 #pragma once
 #include "EuroScopePlugIn.h"
 #include "constants.h"
-#include "CSiTRadar.h"
+#include "TargetStore.h"
+#include "tagRender.h"
 #include <gdiplus.h>
 
+// ground tag colour coding
+const int GND_DEP = 0;
+const int GND_ARR = 1;
+const int GND_OTHER = 2;
+
+// pens, brush and font for the ground tags; made once per screen instead of per tag
+struct GndTagStyle {
+    HPEN pens[3] = { NULL, NULL, NULL };
+    COLORREF colors[3] = { RGB(200, 0, 0), RGB(0, 0, 200), RGB(150, 150, 150) };
+    HBRUSH background = NULL;
+    HFONT font = NULL;
+};
+
 class GndRadar :
     public EuroScopePlugIn::CRadarScreen
 {
 public:
-    static RECT DrawGndTag(HDC hdc, POINT p, int sts, CRadarTarget targ, const char *tagText) {
-        CDC dc;
-        dc.Attach(hdc);
+    static void MakeStyle(GndTagStyle& style)
+    {
+        if (style.font != NULL) {
+            return;
+        }
+
+        for (int i = 0; i < 3; i++) {
+            style.pens[i] = CreatePen(PS_SOLID, 1, style.colors[i]);
+        }
+        style.background = CreateSolidBrush(RGB(50, 50, 50));
+
+        LOGFONT lgfont;
+        memset(&lgfont, 0, sizeof(LOGFONT));
+        lgfont.lfHeight = 12;
+        lgfont.lfWeight = 400;
+        style.font = CreateFontIndirect(&lgfont);
+    };
+
+    static void FreeStyle(GndTagStyle& style)
+    {
+        for (int i = 0; i < 3; i++) {
+            if (style.pens[i] != NULL) { DeleteObject(style.pens[i]); style.pens[i] = NULL; }
+        }
+        if (style.background != NULL) { DeleteObject(style.background); style.background = NULL; }
+        if (style.font != NULL) { DeleteObject(style.font); style.font = NULL; }
+    };
+
+    // departure or arrival for the aerodrome being shown; the indices were resolved
+    // when the flight plan was classified, so this is two integer compares
+    static int Status(const TargetData& td, int airport)
+    {
+        if (td.originApt == airport) { return GND_DEP; }
+        if (td.destApt == airport) { return GND_ARR; }
+        return GND_OTHER;
+    };
+
+    // callsign and type; like the data blocks, only measured again when the text changes.
+    // The ground font must already be selected
+    static bool UpdateGndLayout(CDC& dc, TagLayout& layout, const char* callSign, const TargetData& td)
+    {
+        if (layout.version == td.version && layout.lineCount > 0) {
+            return false;
+        }
 
-        COLORREF depColor = RGB(200, 0, 0);
-        COLORREF arrColor = RGB(0, 0, 200);
+        string lines[2] = { callSign, td.acType };
+        int n = td.acType.empty() ? 1 : 2;
 
-        COLORREF tagColor = RGB(0,0,0);
+        bool measured = false;
+        CSize extent;
+        extent.cx = 0;
+        extent.cy = 0;
+        for (int i = 0; i < n; i++) {
+            if (i >= layout.lineCount || lines[i] != layout.lines[i]) {
+                layout.lines[i] = lines[i];
+                layout.sizes[i] = dc.GetTextExtent(lines[i].c_str(), (int)lines[i].size());
+                measured = true;
+            }
+            extent.cx = max(extent.cx, layout.sizes[i].cx);
+            extent.cy += layout.sizes[i].cy;
+        }
 
-        if (sts == 0) { tagColor = depColor; }
-        if (sts == 1) { tagColor = arrColor; }
- 
-        HPEN targetPen = CreatePen(PS_SOLID, 1, tagColor);
-        HBRUSH targetBrush = CreateSolidBrush(RGB(50,50,50));
+        layout.lineCount = n;
+        layout.extent = extent;
+        layout.version = td.version;
+
+        return measured;
+    };
+
+    // the ground font, background brush and text mode are selected once by the caller
+    static RECT DrawGndTag(CDC& dc, const GndTagStyle& style, POINT p, int sts, const TagLayout& layout) {
 
         // offset the tag location
         p.x += 10;
         p.y -= 25;
         RECT rect;
         rect.left = p.x;
-        rect.right = p.x + 60;
+        rect.right = p.x + layout.extent.cx + 4;
         rect.top = p.y;
-        rect.bottom = p.y + 15;
+        rect.bottom = p.y + layout.extent.cy + 4;
 
-        dc.SelectObject(targetPen);
-        dc.SelectObject(targetBrush);
+        dc.SelectObject(style.pens[sts]);
 
         POINT roundness;
         roundness.x = 3;
         roundness.y = 3;
         dc.RoundRect(&rect, roundness);
 
-        CFont font;
-        LOGFONT lgfont;
-
-        memset(&lgfont, 0, sizeof(LOGFONT));
-        lgfont.lfHeight = 12;
-        lgfont.lfWeight = 400;
-        font.CreateFontIndirect(&lgfont);
-        dc.SelectObject(font);
-        dc.SetTextColor(tagColor);
-
-        rect.left += 2; // add padding
-        rect.top += 2;
-
-        dc.DrawText(CString(tagText), &rect, DT_LEFT);
-
-        DeleteObject(targetBrush);
-        DeleteObject(targetPen);
+        dc.SetTextColor(style.colors[sts]);
 
-        dc.Detach();
+        // add padding
+        int y = rect.top + 2;
+        for (int i = 0; i < layout.lineCount; i++) {
+            dc.TextOut(rect.left + 2, y, layout.lines[i].c_str(), (int)layout.lines[i].size());
+            y += layout.sizes[i].cy;
+        }
 
-        TAG_TYPE_DETAILED;
         return rect;
     }
-};
\ No newline at end of file
+};
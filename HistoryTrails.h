@@ -0,0 +1,129 @@
+#pragma once
+#include "EuroScopePlugIn.h"
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <cstdint>
+#include <cmath>
+
+using namespace std;
+using namespace EuroScopePlugIn;
+
+// previous positions kept per target
+const int TRAIL_CAPACITY = 16;
+
+// fixed point degrees, about a metre; int16 deltas then reach about 18 NM
+const int TRAIL_UNITS = 100000;
+
+// The target's current position in fixed point, and its previous positions as int16
+// offsets from it in a ring, newest at head. Offsets are whole units, so moving them
+// onto a new current position is exact and never drifts.
+struct TrailBuffer {
+    int32_t lat = 0;
+    int32_t lon = 0;
+    int16_t dLat[TRAIL_CAPACITY];
+    int16_t dLon[TRAIL_CAPACITY];
+    uint8_t head = 0;
+    uint8_t count = 0;
+};
+
+// History dots for every target, fed from the position updates so drawing them never
+// goes back to ES's history. Buffers sit in one vector and are reused, so memory
+// stays flat however many targets come and go.
+class HistoryTrails
+{
+public:
+    void Append(const string& callsign, CPosition pos)
+    {
+        int32_t lat = (int32_t)lround(pos.m_Latitude * TRAIL_UNITS);
+        int32_t lon = (int32_t)lround(pos.m_Longitude * TRAIL_UNITS);
+
+        auto it = slots.find(callsign);
+        if (it == slots.end()) {
+            int slot;
+            if (!freeSlots.empty()) {
+                slot = freeSlots.back();
+                freeSlots.pop_back();
+            }
+            else {
+                slot = (int)buffers.size();
+                buffers.push_back(TrailBuffer());
+            }
+            slots[callsign] = slot;
+
+            TrailBuffer& t = buffers[slot];
+            t.lat = lat;
+            t.lon = lon;
+            t.head = 0;
+            t.count = 0;
+            return;
+        }
+
+        TrailBuffer& t = buffers[it->second];
+        int32_t mLat = t.lat - lat;
+        int32_t mLon = t.lon - lon;
+        if (mLat == 0 && mLon == 0) {
+            return;
+        }
+
+        // re-base the older points on the new position; anything that no longer fits
+        // in an offset is too far back to draw and is dropped with everything older
+        int kept = 0;
+        for (; kept < t.count; kept++) {
+            int i = (t.head + kept) % TRAIL_CAPACITY;
+            int32_t nLat = t.dLat[i] + mLat;
+            int32_t nLon = t.dLon[i] + mLon;
+            if (nLat < INT16_MIN || nLat > INT16_MAX || nLon < INT16_MIN || nLon > INT16_MAX) {
+                break;
+            }
+            t.dLat[i] = (int16_t)nLat;
+            t.dLon[i] = (int16_t)nLon;
+        }
+        t.count = (uint8_t)kept;
+
+        t.lat = lat;
+        t.lon = lon;
+        if (mLat < INT16_MIN || mLat > INT16_MAX || mLon < INT16_MIN || mLon > INT16_MAX) {
+            t.count = 0; // jumped, start the trail again
+            return;
+        }
+
+        t.head = (uint8_t)((t.head + TRAIL_CAPACITY - 1) % TRAIL_CAPACITY);
+        t.dLat[t.head] = (int16_t)mLat;
+        t.dLon[t.head] = (int16_t)mLon;
+        if (t.count < TRAIL_CAPACITY) {
+            t.count++;
+        }
+    };
+
+    void Remove(const string& callsign)
+    {
+        auto it = slots.find(callsign);
+        if (it != slots.end()) {
+            freeSlots.push_back(it->second);
+            slots.erase(it);
+        }
+    };
+
+    const TrailBuffer* Find(const string& callsign) const
+    {
+        auto it = slots.find(callsign);
+        return it == slots.end() ? nullptr : &buffers[it->second];
+    };
+
+    // i-th previous position, 0 is the newest
+    static CPosition Point(const TrailBuffer& t, int i)
+    {
+        int idx = (t.head + i) % TRAIL_CAPACITY;
+
+        CPosition pos;
+        pos.m_Latitude = (double)(t.lat + t.dLat[idx]) / TRAIL_UNITS;
+        pos.m_Longitude = (double)(t.lon + t.dLon[idx]) / TRAIL_UNITS;
+        return pos;
+    };
+
+protected:
+    vector<TrailBuffer> buffers;
+    vector<int> freeSlots;
+    unordered_map<string, int> slots;
+};
@@ -0,0 +1,79 @@
+#pragma once
+#include <vector>
+#include <cmath>
+
+using namespace std;
+
+// Douglas-Peucker polyline simplification, keeps the end points and every vertex
+// further than tol from the chord it would be dropped onto
+class LineSimplify
+{
+public:
+    template <typename T>
+    static void DouglasPeucker(const vector<T>& in, double tol, vector<T>& out)
+    {
+        if (in.size() < 3) {
+            out.insert(out.end(), in.begin(), in.end());
+            return;
+        }
+
+        vector<bool> keep(in.size(), false);
+        keep.front() = true;
+        keep.back() = true;
+
+        // explicit stack of [first, last] spans instead of recursion
+        vector<pair<size_t, size_t>> spans;
+        spans.push_back(make_pair((size_t)0, in.size() - 1));
+
+        double tol2 = tol * tol;
+
+        while (!spans.empty()) {
+            size_t first = spans.back().first;
+            size_t last = spans.back().second;
+            spans.pop_back();
+
+            double maxd = 0;
+            size_t maxi = first;
+
+            for (size_t i = first + 1; i < last; i++) {
+                double d = SegDist2((double)in[i].x, (double)in[i].y,
+                    (double)in[first].x, (double)in[first].y, (double)in[last].x, (double)in[last].y);
+                if (d > maxd) {
+                    maxd = d;
+                    maxi = i;
+                }
+            }
+
+            if (maxd > tol2) {
+                keep[maxi] = true;
+                if (maxi - first > 1) { spans.push_back(make_pair(first, maxi)); }
+                if (last - maxi > 1) { spans.push_back(make_pair(maxi, last)); }
+            }
+        }
+
+        for (size_t i = 0; i < in.size(); i++) {
+            if (keep[i]) {
+                out.push_back(in[i]);
+            }
+        }
+    };
+
+    // squared distance from (px, py) to the segment (ax, ay) - (bx, by)
+    static double SegDist2(double px, double py, double ax, double ay, double bx, double by)
+    {
+        double dx = bx - ax;
+        double dy = by - ay;
+        double len2 = dx * dx + dy * dy;
+
+        double t = 0;
+        if (len2 > 0) {
+            t = ((px - ax) * dx + (py - ay) * dy) / len2;
+            t = t < 0 ? 0 : (t > 1 ? 1 : t);
+        }
+
+        double ex = ax + t * dx - px;
+        double ey = ay + t * dy - py;
+
+        return ex * ex + ey * ey;
+    };
+};
@@ -0,0 +1,234 @@
+#include "pch.h"
+#include "MTCD.h"
+#include "SpatialHash.h"
+#include <algorithm>
+
+// altitude band height used to bucket flights inside a time slice
+const int MTCD_BAND_FT = 4000;
+
+// sub steps checked along each one minute slice, so fast closing pairs are not missed between points
+const int MTCD_SUB_STEPS = 6;
+
+MTCDEngine::MTCDEngine()
+{
+	busy = false;
+}
+
+MTCDEngine::~MTCDEngine()
+{
+}
+
+void MTCDEngine::UpdateTrajectory(const MTCDTrajectory& traj)
+{
+	// flights with nothing to probe are kept too, with no points, so they are only captured
+	// again after reanchor like everyone else. Probes still running keep the old copy alive
+	// through their snapshot
+	trajs[traj.callsign] = make_shared<const MTCDTrajectory>(traj);
+}
+
+void MTCDEngine::RemoveTrajectory(const string& callsign)
+{
+	trajs.erase(callsign);
+}
+
+bool MTCDEngine::IsStale(const string& callsign, time_t now) const
+{
+	auto t = trajs.find(callsign);
+	return t == trajs.end() || now - t->second->captured >= reanchor;
+}
+
+void MTCDEngine::StartProbe()
+{
+	ASSERT_UI_THREAD();
+
+	if (busy.exchange(true)) {
+		return; // last probe still running, the next timer tick will pick it up
+	}
+
+	TrajSnapshot snap;
+	snap.reserve(trajs.size());
+	for (auto& t : trajs) {
+		if (t.second->pts.size() >= 2) {
+			snap.push_back(t.second);
+		}
+	}
+
+	time_t base = time(NULL);
+	pool->Submit([this, snap, base] {
+		shared_ptr<vector<MTCDConflict>> result = make_shared<vector<MTCDConflict>>();
+		Probe(snap, base, *result);
+
+		pool->Complete([this, result] {
+			results.swap(*result);
+			fresh = true;
+			busy = false;
+		});
+	});
+}
+
+bool MTCDEngine::TakeResults(vector<MTCDConflict>& out)
+{
+	if (!fresh) {
+		return false;
+	}
+
+	out.swap(results);
+	results.clear();
+	fresh = false;
+
+	return true;
+}
+
+void MTCDEngine::Probe(const TrajSnapshot& snap, time_t base, vector<MTCDConflict>& out)
+{
+	vector<vector<MTCDConflict>> perSlice(lookAhead);
+
+	pool->ParallelFor(lookAhead, [&](int slice) {
+		ProbeSlice(snap, base, slice, perSlice[slice]);
+	});
+
+	// keep the first slice each pair loses separation in
+	map<pair<string, string>, MTCDConflict> first;
+	for (auto& s : perSlice) {
+		for (auto& c : s) {
+			auto f = first.find(make_pair(c.a, c.b));
+			if (f == first.end()) {
+				first[make_pair(c.a, c.b)] = c;
+			}
+			else if (c.minutes < f->second.minutes) {
+				f->second = c;
+			}
+		}
+	}
+
+	out.reserve(first.size());
+	for (auto& f : first) {
+		out.push_back(f.second);
+	}
+	sort(out.begin(), out.end(), [](const MTCDConflict& x, const MTCDConflict& y) { return x.minutes < y.minutes; });
+}
+
+void MTCDEngine::ProbeSlice(const TrajSnapshot& snap, time_t base, int slice, vector<MTCDConflict>& out) const
+{
+	// where every flight is at the start and end of this minute
+	vector<MTCDPoint> p0(snap.size());
+	vector<MTCDPoint> p1(snap.size());
+	vector<bool> valid(snap.size(), false);
+
+	double maxMove = 0;
+	int maxClimb = 0;
+
+	for (int i = 0; i < (int)snap.size(); i++) {
+		double t = (double)(base - snap[i]->captured) + slice * 60.0;
+		if (!PositionAt(*snap[i], t, p0[i]) || !PositionAt(*snap[i], t + 60.0, p1[i])) {
+			continue;
+		}
+		valid[i] = true;
+
+		double midLat = Geodesy::ToRad((p0[i].lat + p1[i].lat) / 2.0);
+		double dx = (p1[i].lon - p0[i].lon) * 60.0 * cos(midLat);
+		double dy = (p1[i].lat - p0[i].lat) * 60.0;
+
+		maxMove = max(maxMove, sqrt(dx * dx + dy * dy));
+		maxClimb = max(maxClimb, abs(p1[i].alt - p0[i].alt));
+	}
+
+	double reach = latMin + 2.0 * maxMove;
+	int bandReach = (int)ceil((vertMinHigh + 2.0 * maxClimb) / MTCD_BAND_FT);
+
+	map<int, SpatialHash<int>> bands;
+	for (int i = 0; i < (int)snap.size(); i++) {
+		if (!valid[i]) {
+			continue;
+		}
+
+		CPosition pos;
+		pos.m_Latitude = p0[i].lat;
+		pos.m_Longitude = p0[i].lon;
+
+		int band = p0[i].alt / MTCD_BAND_FT;
+		auto b = bands.find(band);
+		if (b == bands.end()) {
+			b = bands.insert(make_pair(band, SpatialHash<int>(max(reach, 5.0)))).first;
+		}
+		b->second.Update(i, pos);
+	}
+
+	vector<int> near;
+	for (int i = 0; i < (int)snap.size(); i++) {
+		if (!valid[i]) {
+			continue;
+		}
+
+		CPosition pos;
+		pos.m_Latitude = p0[i].lat;
+		pos.m_Longitude = p0[i].lon;
+
+		int band = p0[i].alt / MTCD_BAND_FT;
+		near.clear();
+		for (int bb = band - bandReach; bb <= band + bandReach; bb++) {
+			auto b = bands.find(bb);
+			if (b != bands.end()) {
+				b->second.Query(pos, reach, near);
+			}
+		}
+
+		for (int j : near) {
+			if (j <= i) {
+				continue;
+			}
+
+			// both flights move in a straight line across the minute, check along it
+			for (int s = 0; s <= MTCD_SUB_STEPS; s++) {
+				double f = (double)s / MTCD_SUB_STEPS;
+
+				double latA = p0[i].lat + (p1[i].lat - p0[i].lat) * f;
+				double lonA = p0[i].lon + (p1[i].lon - p0[i].lon) * f;
+				double altA = p0[i].alt + (p1[i].alt - p0[i].alt) * f;
+				double latB = p0[j].lat + (p1[j].lat - p0[j].lat) * f;
+				double lonB = p0[j].lon + (p1[j].lon - p0[j].lon) * f;
+				double altB = p0[j].alt + (p1[j].alt - p0[j].alt) * f;
+
+				int vmin = max(altA, altB) > 41000 ? vertMinHigh : vertMin;
+				if (fabs(altA - altB) >= vmin) {
+					continue;
+				}
+
+				double dx = (lonB - lonA) * 60.0 * cos(Geodesy::ToRad((latA + latB) / 2.0));
+				double dy = (latB - latA) * 60.0;
+				double d = sqrt(dx * dx + dy * dy);
+
+				if (d < latMin) {
+					MTCDConflict c;
+					c.a = min(snap[i]->callsign, snap[j]->callsign);
+					c.b = max(snap[i]->callsign, snap[j]->callsign);
+					c.minutes = slice;
+					c.dist = d;
+					out.push_back(c);
+					break;
+				}
+			}
+		}
+	}
+}
+
+bool MTCDEngine::PositionAt(const MTCDTrajectory& traj, double t, MTCDPoint& out)
+{
+	// t is seconds after the trajectory was captured
+	double idx = t / 60.0;
+	if (idx < 0 || idx > traj.pts.size() - 1) {
+		return false;
+	}
+
+	int i = min((int)idx, (int)traj.pts.size() - 2);
+	double f = idx - i;
+
+	const MTCDPoint& a = traj.pts[i];
+	const MTCDPoint& b = traj.pts[i + 1];
+
+	out.lat = (float)(a.lat + (b.lat - a.lat) * f);
+	out.lon = (float)(a.lon + (b.lon - a.lon) * f);
+	out.alt = (int)(a.alt + (b.alt - a.alt) * f);
+
+	return true;
+}
@@ -0,0 +1,82 @@
+#pragma once
+#include "ThreadPool.h"
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+#include <atomic>
+#include <ctime>
+
+using namespace std;
+
+// one prediction point, a minute apart
+struct MTCDPoint {
+    float lat = 0;
+    float lon = 0;
+    int alt = 0;
+};
+
+// compact copy of a flight plan's position predictions, taken on the UI thread;
+// pts[i] is where the flight will be i minutes after captured. No points when the
+// flight had nothing to probe, e.g. still on the ground
+struct MTCDTrajectory {
+    string callsign;
+    time_t captured = 0;
+    vector<MTCDPoint> pts;
+};
+
+struct MTCDConflict {
+    string a;
+    string b;
+    int minutes = 0; // until separation is first lost
+    double dist = 0; // NM, at that moment
+};
+
+// Medium term conflict detection. Compares the route based trajectories of every
+// flight over the next 20 minutes on the plugin's pool: each one minute slice
+// is its own task, and inside a slice flights are bucketed by altitude band and
+// position so only neighbours are compared.
+class MTCDEngine
+{
+public:
+    MTCDEngine(void);
+    ~MTCDEngine(void);
+
+    void SetPool(ThreadPool* p) { pool = p; };
+
+    // UI thread: replace or drop a flight's trajectory
+    void UpdateTrajectory(const MTCDTrajectory& traj);
+    void RemoveTrajectory(const string& callsign);
+
+    // UI thread: true if there is no trajectory yet or it is older than reanchor seconds
+    bool IsStale(const string& callsign, time_t now) const;
+
+    // UI thread: start a probe over the current trajectories unless one is still running
+    void StartProbe();
+
+    // UI thread: true and the conflict list if a probe finished since the last call
+    bool TakeResults(vector<MTCDConflict>& out);
+
+    double latMin = 5; // NM
+    int vertMin = 1000; // ft
+    int vertMinHigh = 2000; // ft, above FL410
+    int lookAhead = 20; // minutes
+    int reanchor = 120; // seconds
+
+protected:
+    typedef vector<shared_ptr<const MTCDTrajectory>> TrajSnapshot;
+
+    void Probe(const TrajSnapshot& snap, time_t base, vector<MTCDConflict>& out);
+    void ProbeSlice(const TrajSnapshot& snap, time_t base, int slice, vector<MTCDConflict>& out) const;
+    static bool PositionAt(const MTCDTrajectory& traj, double t, MTCDPoint& out);
+
+    ThreadPool* pool = nullptr;
+
+    // UI thread only
+    map<string, shared_ptr<const MTCDTrajectory>> trajs;
+    vector<MTCDConflict> results;
+    bool fresh = false;
+
+    // set while a probe is queued or running
+    atomic<bool> busy;
+};
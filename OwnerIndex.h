@@ -0,0 +1,125 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+#include <cstdint>
+
+using namespace std;
+
+// Targets by the position tracking them, as a bitset per position over the track filter
+// slots. Kept up to date from the flight plan callbacks as tracks change hands, so
+// finding everything a set of positions owns is an OR of their bitsets rather than a
+// string compare per target every frame
+class OwnerIndex
+{
+public:
+    // moves the slot to the owner's set; an empty owner is untracked. False when it was
+    // already there, so it can be called on every report
+    bool Set(int slot, const char* owner)
+    {
+        if (slot < 0) {
+            return false;
+        }
+        if (slot >= (int)owners.size()) {
+            owners.resize(slot + 1);
+        }
+        if (owners[slot] == owner) {
+            return false;
+        }
+
+        Clear(slot);
+        owners[slot] = owner;
+        if (owners[slot].empty()) {
+            return true;
+        }
+
+        vector<uint64_t>& bits = sets[owner];
+        if ((size_t)(slot >> 6) >= bits.size()) {
+            bits.resize((slot >> 6) + 1, 0);
+        }
+        bits[slot >> 6] |= (uint64_t)1 << (slot & 63);
+        return true;
+    };
+
+    void Clear(int slot)
+    {
+        if (slot < 0 || slot >= (int)owners.size() || owners[slot].empty()) {
+            return;
+        }
+
+        auto it = sets.find(owners[slot]);
+        if (it != sets.end()) {
+            it->second[slot >> 6] &= ~((uint64_t)1 << (slot & 63));
+
+            // a position that tracks nothing any more drops out of the list
+            bool any = false;
+            for (uint64_t w : it->second) {
+                any |= w != 0;
+            }
+            if (!any) {
+                sets.erase(it);
+            }
+        }
+        owners[slot].clear();
+    };
+
+    // the position went away, and whatever it was tracking with it
+    void Release(const string& owner)
+    {
+        auto it = sets.find(owner);
+        if (it == sets.end()) {
+            return;
+        }
+        for (string& o : owners) {
+            if (o == owner) {
+                o.clear();
+            }
+        }
+        sets.erase(it);
+    };
+
+    // everything the positions own, ORed into out; out is grown to fit
+    template <typename Vec>
+    void Gather(const set<string>& positions, Vec& out) const
+    {
+        for (const string& pos : positions) {
+            auto it = sets.find(pos);
+            if (it == sets.end()) {
+                continue;
+            }
+            if (out.size() < it->second.size()) {
+                out.resize(it->second.size(), 0);
+            }
+            for (size_t w = 0; w < it->second.size(); w++) {
+                out[w] |= it->second[w];
+            }
+        }
+    };
+
+    template <typename Vec>
+    static bool Has(const Vec& bits, int slot)
+    {
+        return slot >= 0 && (size_t)(slot >> 6) < bits.size() && ((bits[slot >> 6] >> (slot & 63)) & 1);
+    };
+
+    // positions tracking at least one target, and how many
+    map<string, int> Positions() const
+    {
+        map<string, int> out;
+        for (const auto& s : sets) {
+            int n = 0;
+            for (uint64_t w : s.second) {
+                for (; w != 0; w &= w - 1) {
+                    n++;
+                }
+            }
+            out[s.first] = n;
+        }
+        return out;
+    };
+
+protected:
+    map<string, vector<uint64_t>> sets;
+    vector<string> owners; // by slot
+};
@@ -0,0 +1,10 @@
+#include "pch.h"
+#include "PTLTool.h"
+
+PTLTool::PTLTool()
+{
+}
+
+PTLTool::~PTLTool()
+{
+}
@@ -0,0 +1,48 @@
+#pragma once
+#include "EuroScopePlugIn.h"
+#include "Geodesy.h"
+#include "FrameArena.h"
+#include <vector>
+
+using namespace std;
+using namespace EuroScopePlugIn;
+
+class PTLTool :
+    public CRadarScreen
+{
+public:
+    PTLTool(void);
+    ~PTLTool(void);
+
+    // end point of the predicted track line, ptlMin minutes ahead along the track.
+    // Only called when the target position updates, never in the frame loop
+    static CPosition CalcPTLEnd(CPosition pos, double trk, int gs, double ptlMin)
+    {
+        double dist = gs * ptlMin / 60.0;
+
+        return Geodesy::DestinationPoint(pos, trk, dist);
+    };
+
+    // draws every ptl of the frame with a single pen and one GDI call;
+    // pts holds the start and end point of each line back to back
+    static void DrawPTLs(HDC hdc, FrameVector<POINT>& pts)
+    {
+        if (pts.size() < 2) {
+            return;
+        }
+
+        CDC dc;
+        dc.Attach(hdc);
+
+        FrameVector<DWORD> counts(pts.size() / 2, 2);
+
+        COLORREF targetPenColor = RGB(202, 205, 169);
+        HPEN targetPen = CreatePen(PS_SOLID, 1, targetPenColor);
+        dc.SelectObject(targetPen);
+
+        dc.PolyPolyline(&pts[0], &counts[0], (int)counts.size());
+
+        DeleteObject(targetPen);
+        dc.Detach();
+    };
+};
@@ -0,0 +1,10 @@
+#include "pch.h"
+#include "RBLTool.h"
+
+RBLTool::RBLTool()
+{
+}
+
+RBLTool::~RBLTool()
+{
+}
@@ -0,0 +1,99 @@
+#pragma once
+#include "EuroScopePlugIn.h"
+#include "Geodesy.h"
+#include "FrameArena.h"
+#include <string>
+#include <vector>
+
+using namespace std;
+using namespace EuroScopePlugIn;
+
+// one end of a range bearing line: either a radar target (callsign set) or a fixed point
+struct RBLAnchor {
+    string callsign;
+    CPosition pos;
+};
+
+struct RBL {
+    RBLAnchor a;
+    RBLAnchor b;
+
+    // recalculated only when one of the anchors moves
+    double range = 0;
+    double brg = 0; // magnetic, from a to b
+    InlineString<16> label;
+};
+
+class RBLTool :
+    public CRadarScreen
+{
+public:
+    RBLTool(void);
+    ~RBLTool(void);
+
+    // range, bearing and the label text; plugin side maths so there is no SDK call
+    static void CalcRBL(RBL& rbl, double magvar)
+    {
+        rbl.range = Geodesy::DistanceNM(rbl.a.pos, rbl.b.pos);
+        rbl.brg = fmod(Geodesy::BearingTrue(rbl.a.pos, rbl.b.pos) + magvar + 360.0, 360.0);
+
+        int brg = (int)round(rbl.brg);
+        if (brg == 0) { brg = 360; }
+
+        // "045/12.3"
+        rbl.label.clear();
+        if (brg < 100) { rbl.label.Append('0'); }
+        if (brg < 10) { rbl.label.Append('0'); }
+        rbl.label.Append(brg).Append('/').Append(rbl.range, 1);
+    };
+
+    // draws all the lines with one pen and one GDI call, then the labels at the mid points
+    static void DrawRBLs(HDC hdc, FrameVector<POINT>& pts, FrameVector<const char*>& labels)
+    {
+        if (pts.size() < 2) {
+            return;
+        }
+
+        CDC dc;
+        dc.Attach(hdc);
+
+        FrameVector<DWORD> counts(pts.size() / 2, 2);
+
+        COLORREF targetPenColor = RGB(202, 205, 169);
+        HPEN targetPen = CreatePen(PS_SOLID, 1, targetPenColor);
+        dc.SelectObject(targetPen);
+
+        dc.PolyPolyline(&pts[0], &counts[0], (int)counts.size());
+
+        CFont font;
+        LOGFONT lgfont;
+
+        memset(&lgfont, 0, sizeof(LOGFONT));
+        lgfont.lfWeight = 500;
+        strcpy_s(lgfont.lfFaceName, _T("EuroScope"));
+        lgfont.lfHeight = 12;
+        font.CreateFontIndirect(&lgfont);
+
+        dc.SelectObject(font);
+        dc.SetTextColor(RGB(202, 205, 169));
+
+        for (size_t i = 0; i < labels.size(); i++) {
+            POINT mid = RBLTool::LabelPoint(pts[2 * i], pts[2 * i + 1]);
+            dc.TextOut(mid.x, mid.y, labels[i], (int)strlen(labels[i]));
+        }
+
+        DeleteObject(targetPen);
+        DeleteObject(font);
+        dc.Detach();
+    };
+
+    // label sits just off the mid point of the line
+    static POINT LabelPoint(POINT a, POINT b)
+    {
+        POINT mid;
+        mid.x = (a.x + b.x) / 2 + 4;
+        mid.y = (a.y + b.y) / 2 - 14;
+
+        return mid;
+    };
+};
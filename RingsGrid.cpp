@@ -0,0 +1,135 @@
+#include "pch.h"
+#include "RingsGrid.h"
+#include "LineSimplify.h"
+
+RingsGrid::RingsGrid()
+{
+}
+
+RingsGrid::~RingsGrid()
+{
+}
+
+void RingsGrid::BuildRings(CRadarScreen* radscr, CPosition centre, double spacing, RingsGridCache& cache)
+{
+	if (spacing <= 0) {
+		return;
+	}
+
+	RECT area = radscr->GetRadarArea();
+
+	// rings only need to reach the furthest corner of the display
+	CPosition ll = cache.ll;
+	CPosition ur = cache.ur;
+	CPosition lr; lr.m_Latitude = ll.m_Latitude; lr.m_Longitude = ur.m_Longitude;
+	CPosition ul; ul.m_Latitude = ur.m_Latitude; ul.m_Longitude = ll.m_Longitude;
+
+	double maxDist = max(max(Geodesy::DistanceNM(centre, ll), Geodesy::DistanceNM(centre, ur)),
+		max(Geodesy::DistanceNM(centre, lr), Geodesy::DistanceNM(centre, ul)));
+
+	int numRings = min((int)ceil(maxDist / spacing), 50);
+
+	POINT pc = radscr->ConvertCoordFromPositionToPixel(centre);
+
+	for (int k = 1; k <= numRings; k++) {
+		double radius = k * spacing;
+
+		POINT pe = radscr->ConvertCoordFromPositionToPixel(Geodesy::DestinationPoint(centre, 90, radius));
+		double rpx = sqrt((double)(pe.x - pc.x) * (pe.x - pc.x) + (double)(pe.y - pc.y) * (pe.y - pc.y));
+
+		if (rpx <= RINGS_GRID_PIXEL_TOL) {
+			continue;
+		}
+
+		// skip the ring if it does not cross the radar area at all
+		double nx = max((double)area.left, min((double)pc.x, (double)area.right));
+		double ny = max((double)area.top, min((double)pc.y, (double)area.bottom));
+		double nearest = sqrt((nx - pc.x) * (nx - pc.x) + (ny - pc.y) * (ny - pc.y));
+		double fx = max(fabs((double)area.left - pc.x), fabs((double)area.right - pc.x));
+		double fy = max(fabs((double)area.top - pc.y), fabs((double)area.bottom - pc.y));
+		double furthest = sqrt(fx * fx + fy * fy);
+
+		if (rpx < nearest || rpx > furthest) {
+			continue;
+		}
+
+		// fewest chords that stay within the pixel tolerance of the true circle
+		int n = (int)ceil(PI / acos(1.0 - min(RINGS_GRID_PIXEL_TOL / rpx, 1.0)));
+		n = max(12, min(n, 720));
+
+		for (int i = 0; i <= n; i++) {
+			double brg = 360.0 * i / n;
+			cache.pts.push_back(radscr->ConvertCoordFromPositionToPixel(Geodesy::DestinationPoint(centre, brg, radius)));
+		}
+		cache.counts.push_back(n + 1);
+	}
+}
+
+void RingsGrid::BuildGrid(CRadarScreen* radscr, RingsGridCache& cache)
+{
+	double minLat = min(cache.ll.m_Latitude, cache.ur.m_Latitude);
+	double maxLat = max(cache.ll.m_Latitude, cache.ur.m_Latitude);
+	double minLon = min(cache.ll.m_Longitude, cache.ur.m_Longitude);
+	double maxLon = max(cache.ll.m_Longitude, cache.ur.m_Longitude);
+
+	// pick the finest grid step that keeps lines at least 60 px apart
+	CPosition c; c.m_Latitude = (minLat + maxLat) / 2; c.m_Longitude = (minLon + maxLon) / 2;
+	CPosition c1 = c; c1.m_Latitude += 1;
+	POINT p0 = radscr->ConvertCoordFromPositionToPixel(c);
+	POINT p1 = radscr->ConvertCoordFromPositionToPixel(c1);
+	double pxPerDeg = sqrt((double)(p1.x - p0.x) * (p1.x - p0.x) + (double)(p1.y - p0.y) * (p1.y - p0.y));
+
+	const double steps[] = { 1.0 / 12, 1.0 / 6, 0.25, 0.5, 1, 2, 5, 10 };
+	double step = 10;
+	for (double s : steps) {
+		if (s * pxPerDeg >= 60) {
+			step = s;
+			break;
+		}
+	}
+
+	// sample each line, then drop the samples the projection leaves within tolerance of a straight line
+	const int samples = 32;
+	vector<POINT> line;
+
+	for (double lat = ceil(minLat / step) * step; lat <= maxLat; lat += step) {
+		line.clear();
+		for (int i = 0; i <= samples; i++) {
+			CPosition pos;
+			pos.m_Latitude = lat;
+			pos.m_Longitude = minLon + (maxLon - minLon) * i / samples;
+			line.push_back(radscr->ConvertCoordFromPositionToPixel(pos));
+		}
+
+		size_t before = cache.pts.size();
+		LineSimplify::DouglasPeucker(line, RINGS_GRID_PIXEL_TOL, cache.pts);
+		cache.counts.push_back((DWORD)(cache.pts.size() - before));
+	}
+
+	for (double lon = ceil(minLon / step) * step; lon <= maxLon; lon += step) {
+		line.clear();
+		for (int i = 0; i <= samples; i++) {
+			CPosition pos;
+			pos.m_Latitude = minLat + (maxLat - minLat) * i / samples;
+			pos.m_Longitude = lon;
+			line.push_back(radscr->ConvertCoordFromPositionToPixel(pos));
+		}
+
+		size_t before = cache.pts.size();
+		LineSimplify::DouglasPeucker(line, RINGS_GRID_PIXEL_TOL, cache.pts);
+		cache.counts.push_back((DWORD)(cache.pts.size() - before));
+	}
+}
+
+bool RingsGrid::ViewportChanged(CRadarScreen* radscr, const RingsGridCache& cache)
+{
+	CPosition ll, ur;
+	radscr->GetDisplayArea(&ll, &ur);
+	RECT area = radscr->GetRadarArea();
+
+	return !cache.valid
+		|| ll.m_Latitude != cache.ll.m_Latitude || ll.m_Longitude != cache.ll.m_Longitude
+		|| ur.m_Latitude != cache.ur.m_Latitude || ur.m_Longitude != cache.ur.m_Longitude
+		|| area.left != cache.area.left || area.top != cache.area.top
+		|| area.right != cache.area.right || area.bottom != cache.area.bottom;
+}
@@ -0,0 +1,57 @@
+#pragma once
+#include "EuroScopePlugIn.h"
+#include "Geodesy.h"
+#include <vector>
+
+using namespace std;
+using namespace EuroScopePlugIn;
+
+// max pixel error allowed when approximating rings and grid lines with straight segments
+const double RINGS_GRID_PIXEL_TOL = 1.0;
+
+// pixel geometry of the range rings and lat/lon grid, built once for a viewport
+// and redrawn from here every time ES repaints the back bitmap
+struct RingsGridCache {
+    bool valid = false;
+    CPosition ll; // display area the geometry was built for
+    CPosition ur;
+    RECT area = { 0, 0, 0, 0 };
+
+    vector<POINT> pts;
+    vector<DWORD> counts;
+};
+
+class RingsGrid :
+    public CRadarScreen
+{
+public:
+    RingsGrid(void);
+    ~RingsGrid(void);
+
+    // rings every spacing NM around centre, out to the furthest corner of the display
+    static void BuildRings(CRadarScreen* radscr, CPosition centre, double spacing, RingsGridCache& cache);
+
+    // lat/lon lines over the display area, spacing picked from the zoom level
+    static void BuildGrid(CRadarScreen* radscr, RingsGridCache& cache);
+
+    static bool ViewportChanged(CRadarScreen* radscr, const RingsGridCache& cache);
+
+    static void DrawLayer(HDC hdc, RingsGridCache& cache)
+    {
+        if (cache.counts.empty()) {
+            return;
+        }
+
+        CDC dc;
+        dc.Attach(hdc);
+
+        COLORREF targetPenColor = RGB(90, 90, 90);
+        HPEN targetPen = CreatePen(PS_SOLID, 1, targetPenColor);
+        dc.SelectObject(targetPen);
+
+        dc.PolyPolyline(&cache.pts[0], &cache.counts[0], (int)cache.counts.size());
+
+        DeleteObject(targetPen);
+        dc.Detach();
+    };
+};
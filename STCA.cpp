@@ -0,0 +1,192 @@
+#include "pch.h"
+#include "STCA.h"
+#include "SpatialHash.h"
+#include <algorithm>
+#include <set>
+
+// altitude band height used to bucket targets before the pair checks
+const int STCA_BAND_FT = 4000;
+
+// rounds down, so altitudes below the datum land in their own bands rather than sharing band 0
+static int AltBand(int alt)
+{
+	return alt >= 0 ? alt / STCA_BAND_FT : -((-alt + STCA_BAND_FT - 1) / STCA_BAND_FT);
+}
+
+STCAEngine::STCAEngine()
+{
+	busy = false;
+}
+
+STCAEngine::~STCAEngine()
+{
+}
+
+void STCAEngine::Publish(shared_ptr<const TargetMap> snap)
+{
+	ASSERT_UI_THREAD();
+
+	if (snap == published || busy.exchange(true)) {
+		return; // nothing new, or the last probe is still going and this snapshot waits for the next tick
+	}
+	published = snap;
+
+	pool->Submit([this, snap] {
+		STCASnapshot targets;
+		targets.reserve(snap->size());
+		for (auto& td : *snap) {
+			STCATarget t;
+			t.callsign = td.first;
+			t.lat = td.second.fpos.m_Latitude;
+			t.lon = td.second.fpos.m_Longitude;
+			t.alt = td.second.alt;
+			t.vs = td.second.vs;
+			t.gs = td.second.gs;
+			t.trk = td.second.trk;
+			targets.push_back(t);
+		}
+
+		shared_ptr<vector<string>> result = make_shared<vector<string>>();
+		Probe(targets, *result);
+
+		pool->Complete([this, result] {
+			alerts.swap(*result);
+			busy = false;
+		});
+	});
+}
+
+void STCAEngine::Probe(const STCASnapshot& snap, vector<string>& out)
+{
+	// the furthest two targets can close on each other inside the look ahead
+	int maxGs = 0;
+	int maxVs = 0;
+	for (const STCATarget& t : snap) {
+		maxGs = max(maxGs, t.gs);
+		maxVs = max(maxVs, abs(t.vs));
+	}
+	double reach = latMin + 2.0 * maxGs * lookAhead / 3600.0;
+	int bandReach = (int)ceil((vertMin + 2.0 * maxVs * lookAhead / 60.0) / STCA_BAND_FT);
+
+	// bucket the airborne targets by altitude band, then by position inside the band
+	map<int, SpatialHash<int>> bands;
+	for (int i = 0; i < (int)snap.size(); i++) {
+		const STCATarget& t = snap[i];
+		if (t.gs < minSpeed) {
+			continue;
+		}
+
+		CPosition pos;
+		pos.m_Latitude = t.lat;
+		pos.m_Longitude = t.lon;
+
+		int band = AltBand(t.alt);
+		auto b = bands.find(band);
+		if (b == bands.end()) {
+			b = bands.insert(make_pair(band, SpatialHash<int>(max(reach, 5.0)))).first;
+		}
+		b->second.Update(i, pos);
+	}
+
+	set<pair<string, string>> inConflict;
+	vector<int> near;
+
+	for (int i = 0; i < (int)snap.size(); i++) {
+		const STCATarget& a = snap[i];
+		if (a.gs < minSpeed) {
+			continue;
+		}
+
+		CPosition pos;
+		pos.m_Latitude = a.lat;
+		pos.m_Longitude = a.lon;
+
+		int band = AltBand(a.alt);
+		near.clear();
+		for (int bb = band - bandReach; bb <= band + bandReach; bb++) {
+			auto b = bands.find(bb);
+			if (b != bands.end()) {
+				b->second.Query(pos, reach, near);
+			}
+		}
+
+		for (int j : near) {
+			if (j <= i) {
+				continue; // each pair once
+			}
+
+			const STCATarget& b = snap[j];
+			pair<string, string> key = a.callsign < b.callsign ? make_pair(a.callsign, b.callsign) : make_pair(b.callsign, a.callsign);
+
+			if (PredictConflict(a, b)) {
+				inConflict.insert(key);
+			}
+		}
+	}
+
+	// hysteresis: a pair has to conflict for a few cycles in a row before it alerts,
+	// and stay clear for a few cycles before the alert goes away
+	for (auto& key : inConflict) {
+		PairState& ps = pairs[key];
+		ps.hits++;
+		ps.misses = 0;
+		if (ps.hits >= raiseCycles) {
+			ps.alert = true;
+		}
+	}
+
+	for (auto ps = pairs.begin(); ps != pairs.end();) {
+		if (inConflict.find(ps->first) == inConflict.end()) {
+			ps->second.hits = 0;
+			ps->second.misses++;
+			if (ps->second.misses >= clearCycles) {
+				ps->second.alert = false;
+			}
+		}
+
+		if (!ps->second.alert && ps->second.hits == 0) {
+			ps = pairs.erase(ps);
+		}
+		else {
+			ps++;
+		}
+	}
+
+	set<string> inAlert;
+	for (auto& ps : pairs) {
+		if (ps.second.alert) {
+			inAlert.insert(ps.first.first);
+			inAlert.insert(ps.first.second);
+		}
+	}
+
+	out.assign(inAlert.begin(), inAlert.end());
+}
+
+bool STCAEngine::PredictConflict(const STCATarget& a, const STCATarget& b) const
+{
+	double midLat = Geodesy::ToRad((a.lat + b.lat) / 2);
+
+	// relative position (NM) and velocity (NM/s) of b from a, on a flat plane around the pair
+	double dx = (b.lon - a.lon) * 60.0 * cos(midLat);
+	double dy = (b.lat - a.lat) * 60.0;
+
+	double vx = (b.gs * sin(Geodesy::ToRad(b.trk)) - a.gs * sin(Geodesy::ToRad(a.trk))) / 3600.0;
+	double vy = (b.gs * cos(Geodesy::ToRad(b.trk)) - a.gs * cos(Geodesy::ToRad(a.trk))) / 3600.0;
+
+	double dz = b.alt - a.alt;
+	double vz = (b.vs - a.vs) / 60.0;
+
+	// linear prediction, checked every 5 seconds over the look ahead
+	for (int t = 0; t <= lookAhead; t += 5) {
+		double x = dx + vx * t;
+		double y = dy + vy * t;
+		double z = dz + vz * t;
+
+		if (x * x + y * y < latMin * latMin && fabs(z) < vertMin) {
+			return true;
+		}
+	}
+
+	return false;
+}
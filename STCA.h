@@ -0,0 +1,75 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+#include <atomic>
+#include "ThreadPool.h"
+#include "TargetStore.h"
+
+using namespace std;
+
+// what the conflict probe needs from a radar target, copied out of the target store
+// snapshot at the start of each probe
+struct STCATarget {
+    string callsign;
+    double lat = 0;
+    double lon = 0;
+    int alt = 0; // pressure altitude, ft
+    int vs = 0; // ft/min
+    int gs = 0;
+    double trk = 0;
+};
+
+typedef vector<STCATarget> STCASnapshot;
+
+// Short term conflict alert. Probes run as tasks on the plugin's pool so none of the
+// cost lands in OnRefresh. The plugin's one second timer publishes the target store's
+// immutable snapshot, skipped when nothing has reported since the last one, so a probe
+// cycle (and the hysteresis counted in them) is a timer tick rather than a radar sweep.
+// Each probe hands the callsigns in alert back through the pool's completion queue.
+class STCAEngine
+{
+public:
+    STCAEngine(void);
+    ~STCAEngine(void);
+
+    void SetPool(ThreadPool* p) { pool = p; };
+
+    // UI thread: probe the snapshot if it is newer than the last one and the last probe is done
+    void Publish(shared_ptr<const TargetMap> snap);
+
+    // UI thread: sorted callsigns currently in alert, until the next completion is drained
+    const vector<string>& Alerts() const { return alerts; };
+
+    // separation minima and look ahead
+    double latMin = 3; // NM
+    int vertMin = 1000; // ft
+    int lookAhead = 120; // seconds
+    int minSpeed = 60; // kts, slower targets are treated as on the ground
+
+    // hysteresis, in probe cycles
+    int raiseCycles = 2;
+    int clearCycles = 3;
+
+protected:
+    void Probe(const STCASnapshot& snap, vector<string>& out);
+    bool PredictConflict(const STCATarget& a, const STCATarget& b) const;
+
+    ThreadPool* pool = nullptr;
+
+    // UI thread only
+    shared_ptr<const TargetMap> published;
+    vector<string> alerts;
+
+    // set while a probe is queued or running, so only one runs at a time
+    atomic<bool> busy;
+
+    // probe tasks only: per pair hysteresis state
+    struct PairState {
+        int hits = 0;
+        int misses = 0;
+        bool alert = false;
+    };
+    map<pair<string, string>, PairState> pairs;
+};
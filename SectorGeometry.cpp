@@ -0,0 +1,262 @@
+#include "pch.h"
+#include "SectorGeometry.h"
+#include <cstring>
+
+// element types pulled out of the sector file
+static const int CACHED_TYPES[] = {
+	SECTOR_ELEMENT_AIRPORT, SECTOR_ELEMENT_RUNWAY, SECTOR_ELEMENT_FIX, SECTOR_ELEMENT_GEO,
+	SECTOR_ELEMENT_REGIONS, SECTOR_ELEMENT_AIRSPACE, SECTOR_ELEMENT_ARTC, SECTOR_ELEMENT_HIGH_ARTC,
+	SECTOR_ELEMENT_LOW_ARTC, SECTOR_ELEMENT_LOW_AIRWAY, SECTOR_ELEMENT_HIGH_AIRWAY
+};
+
+// guards against an element that never runs out of positions
+const int SECTOR_MAX_POINTS = 100000;
+
+SectorGeometry::SectorGeometry()
+{
+}
+
+SectorGeometry::~SectorGeometry()
+{
+	Release();
+}
+
+bool SectorGeometry::Load(CPlugIn* plugin)
+{
+	Release();
+
+	string sectorFile = plugin->ControllerMyself().GetSectorFileName();
+	uint64_t key = SectorKey(sectorFile);
+
+	if (key != 0 && Map(CachePath(sectorFile), key)) {
+		return true;
+	}
+
+	Build(plugin, key);
+
+	// written to a temporary name first so a half written file is never mapped
+	if (key != 0) {
+		string path = CachePath(sectorFile);
+		string tmp = path + ".tmp";
+
+		HANDLE out = CreateFile(tmp.c_str(), GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+		if (out != INVALID_HANDLE_VALUE) {
+			DWORD written = 0;
+			BOOL ok = WriteFile(out, built.data(), (DWORD)built.size(), &written, NULL);
+			CloseHandle(out);
+
+			if (ok && written == built.size()) {
+				MoveFileEx(tmp.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING);
+			}
+		}
+	}
+
+	return false;
+}
+
+void SectorGeometry::Build(CPlugIn* plugin, uint64_t key)
+{
+	vector<SectorCacheElement> els;
+	vector<SectorCachePoint> pts;
+	string strs(1, '\0'); // offset 0 is the empty string
+
+	auto addString = [&strs](const char* s) -> uint32_t {
+		if (s == nullptr || *s == '\0') {
+			return 0;
+		}
+		uint32_t offset = (uint32_t)strs.size();
+		strs.append(s);
+		strs.push_back('\0');
+		return offset;
+	};
+
+	for (int type : CACHED_TYPES) {
+		for (CSectorElement el = plugin->SectorFileElementSelectFirst(type); el.IsValid();
+			el = plugin->SectorFileElementSelectNext(el, type)) {
+
+			SectorCacheElement e;
+			e.type = type;
+			e.name = addString(el.GetName());
+			e.airport = 0;
+			e.runway[0] = 0;
+			e.runway[1] = 0;
+			if (type == SECTOR_ELEMENT_RUNWAY) {
+				e.airport = addString(el.GetAirportName());
+				e.runway[0] = addString(el.GetRunwayName(0));
+				e.runway[1] = addString(el.GetRunwayName(1));
+			}
+
+			e.firstPoint = (uint32_t)pts.size();
+			CPosition pos;
+			for (int i = 0; i < SECTOR_MAX_POINTS && el.GetPosition(&pos, i); i++) {
+				pts.push_back({ pos.m_Latitude, pos.m_Longitude });
+			}
+			e.pointCount = (uint32_t)pts.size() - e.firstPoint;
+
+			els.push_back(e);
+		}
+	}
+
+	// header, elements, points, strings
+	size_t elBytes = els.size() * sizeof(SectorCacheElement);
+	size_t ptBytes = pts.size() * sizeof(SectorCachePoint);
+	built.assign(sizeof(SectorCacheHeader) + elBytes + ptBytes + strs.size(), 0);
+
+	char* body = built.data() + sizeof(SectorCacheHeader);
+	if (elBytes > 0) { memcpy(body, els.data(), elBytes); }
+	if (ptBytes > 0) { memcpy(body + elBytes, pts.data(), ptBytes); }
+	memcpy(body + elBytes + ptBytes, strs.data(), strs.size());
+
+	SectorCacheHeader h;
+	memcpy(h.magic, "SITG", 4);
+	h.version = SECTOR_CACHE_VERSION;
+	h.sectorKey = key;
+	h.elementCount = (uint32_t)els.size();
+	h.pointCount = (uint32_t)pts.size();
+	h.stringBytes = (uint32_t)strs.size();
+	memcpy(built.data(), &h, sizeof(h));
+
+	Attach(built.data(), built.size(), key);
+}
+
+bool SectorGeometry::Map(const string& path, uint64_t key)
+{
+	file = CreateFile(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (file == INVALID_HANDLE_VALUE) {
+		return false;
+	}
+
+	LARGE_INTEGER size;
+	if (GetFileSizeEx(file, &size) && size.QuadPart >= (LONGLONG)sizeof(SectorCacheHeader)) {
+		mapping = CreateFileMapping(file, NULL, PAGE_READONLY, 0, 0, NULL);
+		if (mapping != NULL) {
+			view = (const char*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+		}
+	}
+
+	if (view != nullptr && Attach(view, (size_t)size.QuadPart, key)) {
+		return true;
+	}
+
+	Release(); // stale or damaged, rebuilt from the sector file
+	return false;
+}
+
+bool SectorGeometry::Attach(const char* base, size_t size, uint64_t key)
+{
+	const SectorCacheHeader* h = (const SectorCacheHeader*)base;
+	if (size < sizeof(SectorCacheHeader) || memcmp(h->magic, "SITG", 4) != 0
+		|| h->version != SECTOR_CACHE_VERSION || h->sectorKey != key) {
+		return false;
+	}
+
+	size_t elBytes = (size_t)h->elementCount * sizeof(SectorCacheElement);
+	size_t ptBytes = (size_t)h->pointCount * sizeof(SectorCachePoint);
+	if (sizeof(SectorCacheHeader) + elBytes + ptBytes + h->stringBytes != size || h->stringBytes == 0) {
+		return false;
+	}
+
+	// the key is the content hash, so only the layout is checked here and not the body
+	const char* body = base + sizeof(SectorCacheHeader);
+	if (body[size - sizeof(SectorCacheHeader) - 1] != '\0') {
+		return false;
+	}
+
+	const SectorCacheElement* els = (const SectorCacheElement*)body;
+
+	header = h;
+	elements = els;
+	points = (const SectorCachePoint*)(body + elBytes);
+	strings = body + elBytes + ptBytes;
+
+	for (int t = 0; t < SECTOR_ELEMENT_NUMBER; t++) {
+		byType[t].clear();
+	}
+	for (uint32_t i = 0; i < h->elementCount; i++) {
+		if (els[i].type >= 0 && els[i].type < SECTOR_ELEMENT_NUMBER) {
+			byType[els[i].type].push_back((int)i);
+		}
+	}
+
+	return true;
+}
+
+void SectorGeometry::Release()
+{
+	header = nullptr;
+	elements = nullptr;
+	points = nullptr;
+	strings = nullptr;
+	for (int t = 0; t < SECTOR_ELEMENT_NUMBER; t++) {
+		byType[t].clear();
+	}
+
+	if (view != nullptr) {
+		UnmapViewOfFile(view);
+		view = nullptr;
+	}
+	if (mapping != NULL) {
+		CloseHandle(mapping);
+		mapping = NULL;
+	}
+	if (file != INVALID_HANDLE_VALUE) {
+		CloseHandle(file);
+		file = INVALID_HANDLE_VALUE;
+	}
+	built.clear();
+}
+
+// 64 bit FNV-1a of the sector file contents, so a new AIRAC under the same name misses
+// and a copy of the same file hits. Reading the file through a mapping is a small part
+// of what walking it through the SDK costs. 0 when it can't be read, and nothing is cached
+uint64_t SectorGeometry::SectorKey(const string& sectorFile)
+{
+	if (sectorFile.empty()) {
+		return 0;
+	}
+
+	HANDLE in = CreateFile(sectorFile.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL,
+		OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if (in == INVALID_HANDLE_VALUE) {
+		return 0;
+	}
+
+	uint64_t hash = 0;
+	LARGE_INTEGER size;
+	if (GetFileSizeEx(in, &size) && size.QuadPart > 0) {
+		HANDLE map = CreateFileMapping(in, NULL, PAGE_READONLY, 0, 0, NULL);
+		if (map != NULL) {
+			const unsigned char* p = (const unsigned char*)MapViewOfFile(map, FILE_MAP_READ, 0, 0, 0);
+			if (p != nullptr) {
+				hash = 14695981039346656037ULL;
+				for (LONGLONG i = 0; i < size.QuadPart; i++) {
+					hash = (hash ^ p[i]) * 1099511628211ULL;
+				}
+				hash = hash == 0 ? 1 : hash;
+				UnmapViewOfFile(p);
+			}
+			CloseHandle(map);
+		}
+	}
+	CloseHandle(in);
+
+	return hash;
+}
+
+// one file per sector file name, in our own folder under temp
+string SectorGeometry::CachePath(const string& sectorFile)
+{
+	char tmp[MAX_PATH];
+	DWORD n = GetTempPath(MAX_PATH, tmp);
+	string dir = string(tmp, n < MAX_PATH ? n : 0) + "VATCANSitu\\";
+	CreateDirectory(dir.c_str(), NULL);
+
+	string name = sectorFile.substr(sectorFile.find_last_of("\\/") + 1);
+	for (char& c : name) {
+		if (c == ':' || c == '*' || c == '?' || c == '"' || c == '<' || c == '>' || c == '|') {
+			c = '_';
+		}
+	}
+
+	return dir + name + ".geo";
+}
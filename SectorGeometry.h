@@ -0,0 +1,92 @@
+#pragma once
+#include "EuroScopePlugIn.h"
+#include <string>
+#include <vector>
+#include <cstdint>
+
+using namespace std;
+using namespace EuroScopePlugIn;
+
+// bump whenever the layout below or the element types that are extracted change
+const uint32_t SECTOR_CACHE_VERSION = 3;
+
+#pragma pack(push, 4)
+struct SectorCacheHeader {
+    char magic[4]; // "SITG"
+    uint32_t version;
+    uint64_t sectorKey; // hash of the sector file contents the cache was built from
+    uint32_t elementCount;
+    uint32_t pointCount;
+    uint32_t stringBytes;
+};
+
+struct SectorCacheElement {
+    int32_t type; // SECTOR_ELEMENT_*
+    uint32_t name; // offsets into the string block
+    uint32_t airport;
+    uint32_t runway[2];
+    uint32_t firstPoint;
+    uint32_t pointCount;
+};
+
+struct SectorCachePoint {
+    double lat;
+    double lon;
+};
+#pragma pack(pop)
+
+// Everything the plugin indexes out of the sector file: airports, runways, fixes, geo
+// lines, regions, sectors, boundaries and airways. Walking the SDK for a national
+// sector file takes seconds, so the first load writes the elements to a binary file in
+// the temp folder, keyed on a hash of the sector file contents, and later loads memory
+// map it and read it in place.
+class SectorGeometry
+{
+public:
+    SectorGeometry(void);
+    ~SectorGeometry(void);
+
+    // UI thread; true when the geometry came from the cache
+    bool Load(CPlugIn* plugin);
+
+    int Count() const { return header != nullptr ? (int)header->elementCount : 0; };
+
+    // indices of the elements of one SECTOR_ELEMENT_* type
+    const vector<int>& OfType(int type) const { return byType[type]; };
+
+    int Type(int el) const { return elements[el].type; };
+    const char* Name(int el) const { return strings + elements[el].name; };
+    const char* AirportName(int el) const { return strings + elements[el].airport; };
+    const char* RunwayName(int el, int end) const { return strings + elements[el].runway[end]; };
+    int PointCount(int el) const { return (int)elements[el].pointCount; };
+
+    CPosition Point(int el, int idx) const
+    {
+        CPosition pos;
+        pos.m_Latitude = points[elements[el].firstPoint + idx].lat;
+        pos.m_Longitude = points[elements[el].firstPoint + idx].lon;
+        return pos;
+    };
+
+protected:
+    void Build(CPlugIn* plugin, uint64_t key);
+    bool Map(const string& path, uint64_t key);
+    bool Attach(const char* base, size_t size, uint64_t key);
+    void Release();
+
+    static uint64_t SectorKey(const string& sectorFile);
+    static string CachePath(const string& sectorFile);
+
+    // the file view when served from the cache, otherwise the freshly built image
+    HANDLE file = INVALID_HANDLE_VALUE;
+    HANDLE mapping = NULL;
+    const char* view = nullptr;
+    vector<char> built;
+
+    const SectorCacheHeader* header = nullptr;
+    const SectorCacheElement* elements = nullptr;
+    const SectorCachePoint* points = nullptr;
+    const char* strings = nullptr;
+
+    vector<int> byType[SECTOR_ELEMENT_NUMBER];
+};
@@ -10,10 +10,76 @@ SituPlugin::SituPlugin()
 		"Ron Yan",
 		"Attribution-NonCommercial 4.0 International (CC BY-NC 4.0)")
 {
+    RegisterTagItemType("Situ Halo", TAG_ITEM_PLANE_HALO);
+    RegisterTagItemType("MTCD Conflict", TAG_ITEM_MTCD_PARTNER);
+    RegisterTagItemType("MTCD Time", TAG_ITEM_MTCD_TIME);
+    RegisterTagItemType("Situ CJS", TAG_ITEM_CJS);
+    RegisterTagItemType("Situ Equipment", TAG_ITEM_EQUIPMENT);
+
+    mtcdList = RegisterFpList("Situ MTCD");
+    if (mtcdList.GetColumnNumber() == 0) {
+        mtcdList.AddColumnDefinition("C/S", 8, false, NULL, EuroScopePlugIn::TAG_ITEM_TYPE_CALLSIGN, NULL, EuroScopePlugIn::TAG_ITEM_FUNCTION_NO, NULL, EuroScopePlugIn::TAG_ITEM_FUNCTION_NO);
+        mtcdList.AddColumnDefinition("With", 8, false, "NAVCANSitu", TAG_ITEM_MTCD_PARTNER, NULL, EuroScopePlugIn::TAG_ITEM_FUNCTION_NO, NULL, EuroScopePlugIn::TAG_ITEM_FUNCTION_NO);
+        mtcdList.AddColumnDefinition("Min", 4, true, "NAVCANSitu", TAG_ITEM_MTCD_TIME, NULL, EuroScopePlugIn::TAG_ITEM_FUNCTION_NO, NULL, EuroScopePlugIn::TAG_ITEM_FUNCTION_NO);
+    }
+
+    stca.SetPool(&pool);
+    mtcd.SetPool(&pool);
 }
 
 SituPlugin::~SituPlugin()
 {
+    StopWorkers();
+}
+
+void SituPlugin::LoadSectorData()
+{
+    ASSERT_UI_THREAD();
+
+    std::shared_ptr<SectorGeometry> geo = std::make_shared<SectorGeometry>();
+    geo->Load(this);
+    geometry = geo;
+    sectorFile = ControllerMyself().GetSectorFileName();
+
+    airports.Load(*geo);
+    surface.Load(*geo, airports);
+    airspace.Load(*geo);
+    targets.SetAirports(&airports);
+    targets.SetSurface(&surface);
+    targets.SetAirspace(&airspace);
+
+    // the task holds its own reference, so a reload can't unmap the geometry under it;
+    // a map built from geometry that has since been replaced is thrown away
+    videoMap.reset();
+    pool.Submit([this, geo] {
+        std::shared_ptr<VideoMapData> vmap = std::make_shared<VideoMapData>();
+        vmap->Build(*geo);
+
+        pool.Complete([this, geo, vmap] {
+            if (geometry == geo) {
+                videoMap = vmap;
+            }
+        });
+    });
+}
+
+void SituPlugin::SelectAirspace(const std::set<std::string>& names)
+{
+    ASSERT_UI_THREAD();
+
+    airspace.Select(names);
+    targets.SetAirspace(&airspace);
+}
+
+void SituPlugin::StartWorkers()
+{
+    pool.Start();
+}
+
+void SituPlugin::StopWorkers()
+{
+    // waits for running tasks, anything still queued is dropped
+    pool.Stop();
 }
 
 EuroScopePlugIn::CRadarScreen* SituPlugin::OnRadarScreenCreated(const char* sDisplayName, bool NeedRadarContent, bool GeoReferenced, bool CanBeSaved, bool CanBeCreated)
@@ -29,4 +95,245 @@ void SituPlugin::OnGetTagItem(EuroScopePlugIn::CFlightPlan FlightPlan,
     int* pColorCode,
     COLORREF* pRGB,
     double* pFontSize) {
-}
\ No newline at end of file
+
+    if (!TagCache::Cached(ItemCode)) {
+        return;
+    }
+
+    // CJS follows tracking and handoffs, which the store only sees in the position reports
+    if (targets.TrackingChanged()) {
+        vector<string> changed;
+        targets.TakeTrackingChanges(changed);
+        for (const string& c : changed) {
+            tagCache.InvalidateItem(c, TAG_ITEM_CJS);
+        }
+    }
+
+    // uncorrelated targets still have a tag, keyed by the target callsign
+    string callsign = FlightPlan.IsValid() ? FlightPlan.GetCallsign() : RadarTarget.GetCallsign();
+
+    // formatted once, then a table read until an event invalidates it
+    TagEntry& e = tagCache.Get(callsign, ItemCode);
+    if (!e.valid) {
+        FormatTagItem(FlightPlan, callsign, ItemCode, e);
+    }
+
+    memcpy(sItemString, e.text, sizeof(e.text));
+    if (e.colorCode != EuroScopePlugIn::TAG_COLOR_DEFAULT) {
+        *pColorCode = e.colorCode;
+        *pRGB = e.rgb;
+    }
+}
+
+void SituPlugin::FormatTagItem(EuroScopePlugIn::CFlightPlan FlightPlan, const string& callsign, int ItemCode, TagEntry& e)
+{
+    string text;
+    e.colorCode = EuroScopePlugIn::TAG_COLOR_DEFAULT;
+    e.valid = true;
+
+    if (ItemCode == TAG_ITEM_PLANE_HALO) {
+        if (haloCount.find(callsign) != haloCount.end()) {
+            text = "H";
+        }
+    }
+
+    if (ItemCode == TAG_ITEM_MTCD_PARTNER || ItemCode == TAG_ITEM_MTCD_TIME) {
+        auto c = mtcdConflicts.find(callsign);
+        if (c != mtcdConflicts.end()) {
+            if (ItemCode == TAG_ITEM_MTCD_PARTNER) {
+                text = c->second.a == callsign ? c->second.b : c->second.a;
+            }
+            else {
+                text = to_string(c->second.minutes);
+            }
+
+            e.colorCode = EuroScopePlugIn::TAG_COLOR_RGB_DEFINED;
+            e.rgb = RGB(230, 215, 20);
+        }
+    }
+
+    if (ItemCode == TAG_ITEM_CJS && FlightPlan.IsValid()) {
+        text = FlightPlan.GetTrackingControllerId();
+
+        // white while being handed off, like the CJS on the scope
+        e.colorCode = EuroScopePlugIn::TAG_COLOR_RGB_DEFINED;
+        e.rgb = strcmp(FlightPlan.GetHandoffTargetControllerId(), "") != 0 ? RGB(255, 255, 255) : RGB(202, 205, 169);
+    }
+
+    if (ItemCode == TAG_ITEM_EQUIPMENT) {
+        const TargetData* td = targets.Find(callsign);
+        if (td == nullptr || !td->classified) {
+            e.valid = false; // try again once the store has classified it
+        }
+        else {
+            if (td->isRVSM || td->capability == 'L' || td->capability == 'W' || td->capability == 'Z') {
+                text += "W";
+            }
+            if (td->isADSB) {
+                text += "A";
+            }
+        }
+    }
+
+    strncpy_s(e.text, sizeof(e.text), text.c_str(), _TRUNCATE);
+}
+
+void SituPlugin::SetHalo(const string& callsign, bool on)
+{
+    if (on) {
+        haloCount[callsign]++;
+    }
+    else {
+        auto h = haloCount.find(callsign);
+        if (h != haloCount.end() && --h->second <= 0) {
+            haloCount.erase(h);
+        }
+    }
+
+    tagCache.Invalidate(callsign);
+}
+
+void SituPlugin::OnRadarTargetPositionUpdate(EuroScopePlugIn::CRadarTarget RadarTarget)
+{
+    ASSERT_UI_THREAD();
+
+    // the store keeps what the screens and conflict probes need, tasks never touch the SDK
+    targets.UpdatePosition(RadarTarget);
+
+    // predictions are relative to when they were taken, so re-take them every so often
+    EuroScopePlugIn::CFlightPlan fp = RadarTarget.GetCorrelatedFlightPlan();
+    if (fp.IsValid() && mtcd.IsStale(RadarTarget.GetCallsign(), time(NULL))) {
+        CaptureTrajectory(fp);
+    }
+}
+
+void SituPlugin::OnFlightPlanDisconnect(EuroScopePlugIn::CFlightPlan FlightPlan)
+{
+    DropTarget(FlightPlan.GetCallsign());
+}
+
+void SituPlugin::DropTarget(const string& callsign)
+{
+    targets.Remove(callsign);
+    mtcd.RemoveTrajectory(callsign);
+    tagCache.Remove(callsign);
+    CSiTRadar::DropTarget(callsign);
+}
+
+void SituPlugin::OnFlightPlanFlightPlanDataUpdate(EuroScopePlugIn::CFlightPlan FlightPlan)
+{
+    // route or equipment changed
+    targets.UpdateFlightPlan(FlightPlan);
+    tagCache.Invalidate(FlightPlan.GetCallsign());
+    CaptureTrajectory(FlightPlan);
+}
+
+void SituPlugin::OnFlightPlanControllerAssignedDataUpdate(EuroScopePlugIn::CFlightPlan FlightPlan, int DataType)
+{
+    targets.UpdateFlightPlan(FlightPlan);
+    tagCache.Invalidate(FlightPlan.GetCallsign());
+
+    // only the assignments that move the predicted trajectory
+    if (DataType == EuroScopePlugIn::CTR_DATA_TYPE_TEMPORARY_ALTITUDE
+        || DataType == EuroScopePlugIn::CTR_DATA_TYPE_FINAL_ALTITUDE
+        || DataType == EuroScopePlugIn::CTR_DATA_TYPE_DIRECT_TO) {
+        CaptureTrajectory(FlightPlan);
+    }
+}
+
+void SituPlugin::OnFlightPlanFlightStripPushed(EuroScopePlugIn::CFlightPlan FlightPlan, const char* sSenderController, const char* sTargetController)
+{
+    // tracking and handoffs move the strip between controllers
+    targets.UpdateOwner(FlightPlan);
+    tagCache.Invalidate(FlightPlan.GetCallsign());
+}
+
+void SituPlugin::OnControllerDisconnect(EuroScopePlugIn::CController Controller)
+{
+    // whatever it was tracking is released
+    targets.ReleaseOwner(Controller.GetPositionId());
+    tagCache.InvalidateItem(TAG_ITEM_CJS);
+}
+
+void SituPlugin::CaptureTrajectory(EuroScopePlugIn::CFlightPlan FlightPlan)
+{
+    ASSERT_UI_THREAD();
+
+    MTCDTrajectory traj;
+    traj.callsign = FlightPlan.GetCallsign();
+    traj.captured = time(NULL);
+
+    // nothing to probe for flights still on the ground
+    if (FlightPlan.GetCorrelatedRadarTarget().IsValid() && FlightPlan.GetCorrelatedRadarTarget().GetGS() >= 60) {
+        EuroScopePlugIn::CFlightPlanPositionPredictions pred = FlightPlan.GetPositionPredictions();
+        // enough to still cover the look ahead when the probe runs on a capture reanchor seconds old
+        int n = min(pred.GetPointsNumber(), mtcd.lookAhead + mtcd.reanchor / 60 + 1);
+
+        traj.pts.reserve(n);
+        for (int i = 0; i < n; i++) {
+            MTCDPoint pt;
+            pt.lat = (float)pred.GetPosition(i).m_Latitude;
+            pt.lon = (float)pred.GetPosition(i).m_Longitude;
+            pt.alt = pred.GetAltitude(i);
+            traj.pts.push_back(pt);
+        }
+    }
+
+    mtcd.UpdateTrajectory(traj);
+}
+
+void SituPlugin::UpdateMTCDList(const vector<MTCDConflict>& conflicts)
+{
+    // conflicts come sorted by time, so the first one seen for a callsign is its earliest
+    map<string, MTCDConflict> byCallsign;
+    for (const MTCDConflict& c : conflicts) {
+        byCallsign.insert(make_pair(c.a, c));
+        byCallsign.insert(make_pair(c.b, c));
+    }
+
+    for (auto& c : mtcdConflicts) {
+        if (byCallsign.find(c.first) == byCallsign.end()) {
+            mtcdList.RemoveFpFromTheList(FlightPlanSelect(c.first.c_str()));
+        }
+    }
+    for (auto& c : byCallsign) {
+        if (mtcdConflicts.find(c.first) == mtcdConflicts.end()) {
+            mtcdList.AddFpToTheList(FlightPlanSelect(c.first.c_str()));
+        }
+    }
+
+    // both the old and the new conflicts need their tag items redone
+    for (auto& c : mtcdConflicts) {
+        tagCache.Invalidate(c.first);
+    }
+    for (auto& c : byCallsign) {
+        tagCache.Invalidate(c.first);
+    }
+
+    mtcdConflicts.swap(byCallsign);
+}
+
+void SituPlugin::OnTimer(int Counter)
+{
+    pool.DrainCompletions();
+
+    // targets that stopped reporting, uncorrelated ones included, go like a disconnect
+    vector<string> expired;
+    targets.Expired(expired);
+    for (const string& c : expired) {
+        DropTarget(c);
+    }
+
+    // once a second the conflict probe gets the latest snapshot, if anything changed
+    stca.Publish(targets.Snapshot());
+
+    vector<MTCDConflict> conflicts;
+    if (mtcd.TakeResults(conflicts)) {
+        UpdateMTCDList(conflicts);
+    }
+
+    // full medium term probe every radar cycle
+    if (Counter % 5 == 0) {
+        mtcd.StartProbe();
+    }
+}
@@ -1,5 +1,14 @@
 #pragma once
 #include <EuroScopePlugIn.h>
+#include "ThreadPool.h"
+#include "TargetStore.h"
+#include "STCA.h"
+#include "MTCD.h"
+#include "TagCache.h"
+#include "VideoMap.h"
+#include <map>
+#include <set>
+#include <string>
 
 class SituPlugin :
     public EuroScopePlugIn::CPlugIn
@@ -17,4 +26,67 @@ public:
         int* pColorCode,
         COLORREF* pRGB,
         double* pFontSize);
+
+    virtual void OnRadarTargetPositionUpdate(EuroScopePlugIn::CRadarTarget RadarTarget);
+
+    virtual void OnFlightPlanDisconnect(EuroScopePlugIn::CFlightPlan FlightPlan);
+
+    virtual void OnFlightPlanFlightPlanDataUpdate(EuroScopePlugIn::CFlightPlan FlightPlan);
+
+    virtual void OnFlightPlanControllerAssignedDataUpdate(EuroScopePlugIn::CFlightPlan FlightPlan, int DataType);
+
+    virtual void OnFlightPlanFlightStripPushed(EuroScopePlugIn::CFlightPlan FlightPlan, const char* sSenderController, const char* sTargetController);
+
+    virtual void OnControllerDisconnect(EuroScopePlugIn::CController Controller);
+
+    virtual void OnTimer(int Counter);
+
+    // a target gone, by flight plan disconnect or by not reporting; forgotten by the
+    // store, the probes, the tag cache and every radar screen
+    void DropTarget(const std::string& callsign);
+
+    // screens report their halos so the halo tag item can show them
+    void SetHalo(const std::string& callsign, bool on);
+
+    // background workers, started and joined from the DLL entry points
+    void StartWorkers();
+    void StopWorkers();
+
+    // shared by everything that works off the UI thread; results come back through
+    // its completion queue, drained at the start of OnRefresh and OnTimer
+    ThreadPool pool;
+
+    // every target the plugin knows about, shared by all the radar screens
+    TargetStore targets;
+
+    // sector file geometry and what is indexed from it, loaded with the first ASR and
+    // again whenever an ASR is opened against a different sector file
+    std::string sectorFile;
+    std::shared_ptr<const SectorGeometry> geometry;
+    AirportIndex airports;
+    SurfaceIndex surface;
+    AirspaceIndex airspace;
+
+    // sector file layers simplified for the video map, null until built on the pool
+    std::shared_ptr<const VideoMapData> videoMap;
+    void LoadSectorData();
+    void SelectAirspace(const std::set<std::string>& names);
+
+    // conflict alert, shared by all the radar screens
+    STCAEngine stca;
+
+    // medium term conflict probe, and its latest result by callsign (first conflict only)
+    MTCDEngine mtcd;
+    std::map<std::string, MTCDConflict> mtcdConflicts;
+
+protected:
+    void FormatTagItem(EuroScopePlugIn::CFlightPlan FlightPlan, const std::string& callsign, int ItemCode, TagEntry& e);
+    void CaptureTrajectory(EuroScopePlugIn::CFlightPlan FlightPlan);
+    void UpdateMTCDList(const std::vector<MTCDConflict>& conflicts);
+
+    EuroScopePlugIn::CFlightPlanList mtcdList;
+
+    // formatted plugin tag items, and how many screens have each callsign haloed
+    TagCache tagCache;
+    std::map<std::string, int> haloCount;
 };
@@ -0,0 +1,174 @@
+#pragma once
+#include "EuroScopePlugIn.h"
+#include "Geodesy.h"
+#include <unordered_map>
+#include <vector>
+#include <string>
+#include <algorithm>
+
+using namespace std;
+using namespace EuroScopePlugIn;
+
+// Uniform grid over lat/lon for neighbour searches. Cells are cellNM tall and
+// cellNM wide at the latitude of the cell row, so a query only looks at the few
+// cells around a position instead of every target. Entries are moved between
+// cells as positions update rather than rebuilt every time. Each row is a whole
+// number of columns round the globe, so column indices wrap at the antimeridian and
+// targets either side of 180 are neighbours.
+template <typename ID>
+class SpatialHash
+{
+public:
+    SpatialHash(double cellNM = 10) { SetCellSize(cellNM); };
+
+    void SetCellSize(double cellNM)
+    {
+        cellSize = cellNM;
+        cells.clear();
+        cellOf.clear();
+    };
+
+    double CellSize() const { return cellSize; };
+
+    // false when the id was already in that cell
+    bool Update(const ID& id, CPosition pos)
+    {
+        long long key = Key(pos);
+
+        auto it = cellOf.find(id);
+        if (it != cellOf.end()) {
+            if (it->second == key) {
+                return false;
+            }
+            Erase(it->second, id);
+            it->second = key;
+        }
+        else {
+            cellOf[id] = key;
+        }
+
+        cells[key].push_back(id);
+        return true;
+    };
+
+    // false when the id wasn't in the grid
+    bool Remove(const ID& id)
+    {
+        auto it = cellOf.find(id);
+        if (it == cellOf.end()) {
+            return false;
+        }
+        Erase(it->second, id);
+        cellOf.erase(it);
+        return true;
+    };
+
+    // every id in the cells that could hold something within radius NM of pos;
+    // callers still need to check the actual distance
+    void Query(CPosition pos, double radius, vector<ID>& out) const
+    {
+        int row = Row(pos.m_Latitude);
+        int reach = (int)ceil(radius / cellSize);
+
+        for (int r = row - reach; r <= row + reach; r++) {
+            int col = Col(pos.m_Longitude, r);
+            int cols = Cols(r);
+
+            // near the poles the reach can go all the way round, and each cell is only wanted once
+            int first = col - reach;
+            int last = col + reach;
+            if (last - first + 1 >= cols) {
+                first = 0;
+                last = cols - 1;
+            }
+
+            for (int c = first; c <= last; c++) {
+                auto cell = cells.find(Pack(r, ((c % cols) + cols) % cols));
+                if (cell != cells.end()) {
+                    out.insert(out.end(), cell->second.begin(), cell->second.end());
+                }
+            }
+        }
+    };
+
+    const unordered_map<long long, vector<ID>>& Cells() const { return cells; };
+
+    void Clear()
+    {
+        cells.clear();
+        cellOf.clear();
+    };
+
+    int Row(double lat) const
+    {
+        return (int)floor(lat * 60.0 / cellSize);
+    };
+
+    // columns are sized on the row's mid latitude so cells stay roughly square,
+    // rounded so a whole number of them goes round the globe
+    int Cols(int row) const
+    {
+        double lat = (row + 0.5) * cellSize / 60.0;
+        double nmPerDeg = max(60.0 * cos(Geodesy::ToRad(lat)), 1.0);
+
+        return max((int)floor(360.0 * nmPerDeg / cellSize), 1);
+    };
+
+    // counted east from 180W, 0 .. Cols(row) - 1
+    int Col(double lon, int row) const
+    {
+        int cols = Cols(row);
+        double east = fmod(lon + 180.0, 360.0);
+        if (east < 0) {
+            east += 360.0;
+        }
+
+        return min((int)floor(east * cols / 360.0), cols - 1);
+    };
+
+    long long Key(CPosition pos) const
+    {
+        int row = Row(pos.m_Latitude);
+        return Pack(row, Col(pos.m_Longitude, row));
+    };
+
+    static long long Pack(int row, int col)
+    {
+        return ((long long)row << 32) | (unsigned int)col;
+    };
+
+    // middle of a cell, from its key
+    CPosition Centre(long long key) const
+    {
+        int row = (int)(key >> 32);
+        int col = (int)(unsigned int)key;
+
+        CPosition pos;
+        pos.m_Latitude = (row + 0.5) * cellSize / 60.0;
+        pos.m_Longitude = (col + 0.5) * 360.0 / Cols(row) - 180.0;
+        return pos;
+    };
+
+protected:
+    void Erase(long long key, const ID& id)
+    {
+        auto cell = cells.find(key);
+        if (cell == cells.end()) {
+            return;
+        }
+
+        vector<ID>& v = cell->second;
+        auto pos = find(v.begin(), v.end(), id);
+        if (pos != v.end()) {
+            *pos = v.back();
+            v.pop_back();
+        }
+        if (v.empty()) {
+            cells.erase(cell);
+        }
+    };
+
+    double cellSize;
+    unordered_map<long long, vector<ID>> cells;
+    unordered_map<ID, long long> cellOf;
+};
@@ -0,0 +1,208 @@
+#pragma once
+#include "EuroScopePlugIn.h"
+#include "AirportIndex.h"
+#include "Geodesy.h"
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <cmath>
+
+using namespace std;
+using namespace EuroScopePlugIn;
+
+const int SURF_RUNWAY = 0;
+const int SURF_TAXI = 1;
+
+// grid cell size and how far either side of a segment's line a target still counts as on it
+const double SURF_CELL_M = 100;
+const double SURF_RUNWAY_HALF_M = 30;
+const double SURF_TAXI_HALF_M = 20;
+
+// elements not named after an aerodrome go to the closest one within this range
+const double SURF_AIRPORT_NM = 5;
+
+// a target has to move this far before its segment is looked up again
+const double SURF_RELOOKUP_M = 5;
+
+struct SurfaceSegment {
+    string name; // runway designators, or the ground layout group it came from
+    int kind = SURF_TAXI;
+    int airport = -1;
+    CPosition a;
+    CPosition b;
+
+    // end points in metres east and north of the aerodrome reference point
+    double ax = 0, ay = 0, bx = 0, by = 0;
+    double halfWidth = SURF_TAXI_HALF_M;
+};
+
+// Runways and ground layout lines from the sector file, bucketed per aerodrome on a
+// local metric grid, so "which segment is this target on" is a cell lookup and a
+// distance check against the handful of segments crossing that cell
+class SurfaceIndex
+{
+public:
+    // sector file runways and geo lines; UI thread, after the airports are loaded
+    void Load(const SectorGeometry& geo, const AirportIndex& airports)
+    {
+        segments.clear();
+        surfaces.assign(airports.Count(), AirportSurface());
+        for (int i = 0; i < airports.Count(); i++) {
+            surfaces[i].ref = airports.Get(i).pos;
+            surfaces[i].mPerDegLon = max(METRES_PER_DEG * cos(Geodesy::ToRad(surfaces[i].ref.m_Latitude)), 1.0);
+        }
+
+        for (int el : geo.OfType(SECTOR_ELEMENT_RUNWAY)) {
+            if (geo.PointCount(el) < 2) {
+                continue;
+            }
+
+            SurfaceSegment seg;
+            seg.kind = SURF_RUNWAY;
+            seg.halfWidth = SURF_RUNWAY_HALF_M;
+            seg.name = string(geo.RunwayName(el, 0)) + "/" + geo.RunwayName(el, 1);
+            seg.a = geo.Point(el, 0);
+            seg.b = geo.Point(el, 1);
+            seg.airport = AirportOf(airports, geo.AirportName(el), seg.a);
+            Add(seg);
+        }
+
+        // geo lines are start and end pairs; only the ones at an aerodrome are kept
+        for (int el : geo.OfType(SECTOR_ELEMENT_GEO)) {
+            if (geo.PointCount(el) < 2) {
+                continue;
+            }
+
+            SurfaceSegment seg;
+            seg.name = geo.Name(el);
+            seg.airport = AirportOf(airports, seg.name, geo.Point(el, 0));
+            if (seg.airport < 0) {
+                continue;
+            }
+
+            for (int i = 0; i + 1 < geo.PointCount(el); i += 2) {
+                seg.a = geo.Point(el, i);
+                seg.b = geo.Point(el, i + 1);
+                Add(seg);
+            }
+        }
+    };
+
+    // the segment pos is on at that aerodrome, runways first, -1 if none
+    int Find(int airport, CPosition pos) const
+    {
+        if (airport < 0 || airport >= (int)surfaces.size()) {
+            return -1;
+        }
+
+        const AirportSurface& s = surfaces[airport];
+        double x, y;
+        ToLocal(s, pos, x, y);
+
+        auto cell = s.cells.find(Pack((int)floor(x / SURF_CELL_M), (int)floor(y / SURF_CELL_M)));
+        if (cell == s.cells.end()) {
+            return -1;
+        }
+
+        int best = -1;
+        double bestDist = 0;
+        for (int idx : cell->second) {
+            const SurfaceSegment& seg = segments[idx];
+            double d = DistToSegment(x, y, seg);
+            if (d > seg.halfWidth) {
+                continue;
+            }
+            if (best < 0 || (seg.kind == SURF_RUNWAY && segments[best].kind != SURF_RUNWAY)
+                || (seg.kind == segments[best].kind && d < bestDist)) {
+                best = idx;
+                bestDist = d;
+            }
+        }
+        return best;
+    };
+
+    // cheap flat distance check for the relookup threshold
+    static bool Moved(CPosition from, CPosition to, double metres)
+    {
+        double dy = (to.m_Latitude - from.m_Latitude) * METRES_PER_DEG;
+        double dx = (to.m_Longitude - from.m_Longitude) * METRES_PER_DEG * cos(Geodesy::ToRad(from.m_Latitude));
+        return dx * dx + dy * dy > metres * metres;
+    };
+
+    const SurfaceSegment& Get(int idx) const { return segments[idx]; };
+    int Count() const { return (int)segments.size(); };
+
+protected:
+    struct AirportSurface {
+        CPosition ref;
+        double mPerDegLon = 0;
+        unordered_map<long long, vector<int>> cells;
+    };
+
+    static constexpr double METRES_PER_DEG = 60 * 1852.0;
+
+    // the element's own aerodrome if it names one we know, else the closest one
+    static int AirportOf(const AirportIndex& airports, const string& name, CPosition pos)
+    {
+        int apt = name.size() >= 4 ? airports.Find(name.substr(0, 4)) : -1;
+        if (apt < 0) {
+            apt = airports.Nearest(pos, SURF_AIRPORT_NM);
+        }
+        return apt;
+    };
+
+    static void ToLocal(const AirportSurface& s, CPosition pos, double& x, double& y)
+    {
+        x = (pos.m_Longitude - s.ref.m_Longitude) * s.mPerDegLon;
+        y = (pos.m_Latitude - s.ref.m_Latitude) * METRES_PER_DEG;
+    };
+
+    static double DistToSegment(double x, double y, const SurfaceSegment& seg)
+    {
+        double dx = seg.bx - seg.ax;
+        double dy = seg.by - seg.ay;
+        double len2 = dx * dx + dy * dy;
+        double t = len2 > 0 ? ((x - seg.ax) * dx + (y - seg.ay) * dy) / len2 : 0;
+        t = max(0.0, min(1.0, t));
+        double px = seg.ax + t * dx - x;
+        double py = seg.ay + t * dy - y;
+        return sqrt(px * px + py * py);
+    };
+
+    static long long Pack(int col, int row)
+    {
+        return ((long long)row << 32) | (unsigned int)col;
+    };
+
+    // registers the segment in every cell whose square could hold a point within its half width
+    void Add(SurfaceSegment seg)
+    {
+        if (seg.airport < 0) {
+            return;
+        }
+
+        AirportSurface& s = surfaces[seg.airport];
+        ToLocal(s, seg.a, seg.ax, seg.ay);
+        ToLocal(s, seg.b, seg.bx, seg.by);
+
+        int idx = (int)segments.size();
+        segments.push_back(seg);
+
+        double reach = seg.halfWidth + SURF_CELL_M * 0.7072; // half the cell diagonal
+        int c0 = (int)floor((min(seg.ax, seg.bx) - seg.halfWidth) / SURF_CELL_M);
+        int c1 = (int)floor((max(seg.ax, seg.bx) + seg.halfWidth) / SURF_CELL_M);
+        int r0 = (int)floor((min(seg.ay, seg.by) - seg.halfWidth) / SURF_CELL_M);
+        int r1 = (int)floor((max(seg.ay, seg.by) + seg.halfWidth) / SURF_CELL_M);
+
+        for (int r = r0; r <= r1; r++) {
+            for (int c = c0; c <= c1; c++) {
+                if (DistToSegment((c + 0.5) * SURF_CELL_M, (r + 0.5) * SURF_CELL_M, seg) <= reach) {
+                    s.cells[Pack(c, r)].push_back(idx);
+                }
+            }
+        }
+    };
+
+    vector<SurfaceSegment> segments;
+    vector<AirportSurface> surfaces; // by airport index
+};
@@ -0,0 +1,69 @@
+#pragma once
+#include "EuroScopePlugIn.h"
+#include <string>
+#include <array>
+#include <unordered_map>
+
+using namespace std;
+
+// plugin tag item codes below this are cached
+const int TAG_CACHE_ITEMS = 8;
+
+// one pre-formatted tag item, ready to copy out to ES
+struct TagEntry {
+    char text[16] = { 0 };
+    int colorCode = 0; // TAG_COLOR_...
+    COLORREF rgb = 0;
+    bool valid = false;
+};
+
+// ES asks for every item of every visible tag on every refresh, but the values only
+// change on a handful of flight plan and controller events. Items are formatted once
+// and then served from here until one of those events invalidates them.
+class TagCache
+{
+public:
+    // the entry for a callsign and item, created empty if it is not there yet
+    TagEntry& Get(const string& callsign, int item)
+    {
+        return entries[callsign][item];
+    };
+
+    void Invalidate(const string& callsign)
+    {
+        auto e = entries.find(callsign);
+        if (e != entries.end()) {
+            for (TagEntry& t : e->second) {
+                t.valid = false;
+            }
+        }
+    };
+
+    void InvalidateItem(const string& callsign, int item)
+    {
+        auto e = entries.find(callsign);
+        if (e != entries.end()) {
+            e->second[item].valid = false;
+        }
+    };
+
+    void InvalidateItem(int item)
+    {
+        for (auto& e : entries) {
+            e.second[item].valid = false;
+        }
+    };
+
+    void Remove(const string& callsign)
+    {
+        entries.erase(callsign);
+    };
+
+    static bool Cached(int item)
+    {
+        return item > 0 && item < TAG_CACHE_ITEMS;
+    };
+
+protected:
+    unordered_map<string, array<TagEntry, TAG_CACHE_ITEMS>> entries;
+};
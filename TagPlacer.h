@@ -0,0 +1,262 @@
+#pragma once
+#include "EuroScopePlugIn.h"
+#include "tagRender.h"
+#include "FrameArena.h"
+#include <string>
+#include <vector>
+#include <map>
+#include <unordered_map>
+#include <set>
+#include <algorithm>
+
+using namespace std;
+
+// screen grid cell size for the overlap searches, px
+const int TAG_GRID_CELL = 32;
+
+// leader directions tried, as offsets from the preferred tag angle
+const int TAG_ANGLE_OFFSETS[] = { 0, 90, 270, 180, 45, 315, 135, 225 };
+
+// Automatic data block placement. Each target's tag and PPS rectangles are kept in a
+// screen grid between frames; only targets whose PPS or tag size changed, and the
+// tags they land on, are placed again, so a frame costs what moved rather than
+// what is on the screen. Each candidate leader direction is scored by how much
+// it overlaps the other tags and symbols around it.
+class TagPlacer
+{
+public:
+    // start of the target loop
+    void BeginFrame() { frame++; };
+
+    // a tag drawn this frame; the layout must stay alive until the target is removed
+    void Update(const string& callsign, POINT p, const TagLayout* layout)
+    {
+        Placed& pl = placed[callsign];
+        pl.frame = frame;
+
+        if (pl.layout == layout && pl.p.x == p.x && pl.p.y == p.y
+            && pl.extent.cx == layout->extent.cx && pl.extent.cy == layout->extent.cy) {
+            return;
+        }
+
+        pl.p = p;
+        pl.layout = layout;
+        pl.extent = layout->extent;
+        pl.dirty = true;
+    };
+
+    void Remove(const string& callsign)
+    {
+        auto pl = placed.find(callsign);
+        if (pl != placed.end()) {
+            Erase(pl->first, pl->second);
+            placed.erase(pl);
+        }
+    };
+
+    // after the target loop: drops the targets not drawn this frame and places the
+    // changed ones. Returns how many tags were placed
+    int Resolve(int leaderLen, int tagAngle)
+    {
+        // the leader settings move every tag
+        if (leaderLen != lastLeaderLen || tagAngle != lastTagAngle) {
+            lastLeaderLen = leaderLen;
+            lastTagAngle = tagAngle;
+            for (auto& pl : placed) {
+                pl.second.dirty = true;
+            }
+        }
+
+        // map entries don't move, so the work lists just point at them
+        typedef pair<const string*, Placed*> Entry;
+
+        FrameVector<Entry> dirty;
+        for (auto pl = placed.begin(); pl != placed.end();) {
+            if (pl->second.frame != frame) {
+                Erase(pl->first, pl->second);
+                pl = placed.erase(pl);
+                continue;
+            }
+            if (pl->second.dirty) {
+                Erase(pl->first, pl->second);
+                dirty.push_back({ &pl->first, &pl->second });
+            }
+            pl++;
+        }
+
+        // place what changed, then give the tags it now sits on one chance to move away
+        FrameVector<Entry> bumped;
+        for (const Entry& d : dirty) {
+            Place(*d.first, *d.second);
+
+            near.clear();
+            Query(d.second->tag, near);
+            for (const string& other : near) {
+                if (other == *d.first) {
+                    continue;
+                }
+                auto o = placed.find(other);
+                if (o != placed.end() && !o->second.dirty && Overlap(d.second->tag, o->second.tag) > 0) {
+                    bumped.push_back({ &o->first, &o->second });
+                }
+            }
+        }
+        sort(bumped.begin(), bumped.end());
+        bumped.erase(unique(bumped.begin(), bumped.end()), bumped.end());
+        for (const Entry& b : bumped) {
+            Erase(*b.first, *b.second);
+            Place(*b.first, *b.second);
+        }
+
+        for (const Entry& d : dirty) {
+            d.second->dirty = false;
+        }
+
+        return (int)(dirty.size() + bumped.size());
+    };
+
+    int Angle(const string& callsign) const
+    {
+        auto pl = placed.find(callsign);
+        return pl == placed.end() ? lastTagAngle : pl->second.angle;
+    };
+
+    void Clear()
+    {
+        placed.clear();
+        grid.clear();
+    };
+
+protected:
+    struct Placed {
+        POINT p = { 0, 0 };
+        CSize extent;
+        const TagLayout* layout = nullptr;
+        int angle = 0;
+        RECT tag = { 0, 0, 0, 0 };
+        RECT pps = { 0, 0, 0, 0 };
+        bool dirty = true;
+        bool inGrid = false;
+        unsigned int frame = 0;
+    };
+
+    void Place(const string& callsign, Placed& pl)
+    {
+        pl.pps = { pl.p.x - 5, pl.p.y - 5, pl.p.x + 5, pl.p.y + 5 };
+
+        double bestCost = -1;
+        for (int i = 0; i < (int)(sizeof(TAG_ANGLE_OFFSETS) / sizeof(TAG_ANGLE_OFFSETS[0])); i++) {
+            int angle = (lastTagAngle + TAG_ANGLE_OFFSETS[i]) % 360;
+            RECT tag = tagRender::TagRect(*pl.layout, pl.p, lastLeaderLen, angle);
+
+            // small bias towards the preferred direction, so free tags do not wander
+            double cost = i * 10.0;
+
+            near.clear();
+            Query(tag, near);
+            for (const string& other : near) {
+                if (other == callsign) {
+                    continue;
+                }
+                const Placed& o = placed[other];
+                cost += Overlap(tag, o.tag) + 2.0 * Overlap(tag, o.pps);
+            }
+
+            if (bestCost < 0 || cost < bestCost) {
+                bestCost = cost;
+                pl.angle = angle;
+                pl.tag = tag;
+            }
+            if (cost == 0) {
+                break; // preferred direction is clear
+            }
+        }
+
+        Insert(callsign, pl);
+    };
+
+    // cells covered by the tag and the PPS
+    template <typename F>
+    void ForCells(const Placed& pl, F f) const
+    {
+        RECT r;
+        r.left = min(pl.tag.left, pl.pps.left);
+        r.top = min(pl.tag.top, pl.pps.top);
+        r.right = max(pl.tag.right, pl.pps.right);
+        r.bottom = max(pl.tag.bottom, pl.pps.bottom);
+
+        for (int cy = Cell(r.top); cy <= Cell(r.bottom); cy++) {
+            for (int cx = Cell(r.left); cx <= Cell(r.right); cx++) {
+                f(Pack(cx, cy));
+            }
+        }
+    };
+
+    void Insert(const string& callsign, Placed& pl)
+    {
+        ForCells(pl, [&](long long key) { grid[key].push_back(callsign); });
+        pl.inGrid = true;
+    };
+
+    void Erase(const string& callsign, Placed& pl)
+    {
+        if (!pl.inGrid) {
+            return;
+        }
+
+        ForCells(pl, [&](long long key) {
+            auto cell = grid.find(key);
+            if (cell == grid.end()) {
+                return;
+            }
+            vector<string>& v = cell->second;
+            auto it = find(v.begin(), v.end(), callsign);
+            if (it != v.end()) {
+                *it = v.back();
+                v.pop_back();
+            }
+            // empty cells are kept, so tags moving about don't allocate new ones
+        });
+        pl.inGrid = false;
+    };
+
+    // every id in the cells the rectangle touches, once each
+    void Query(const RECT& r, vector<string>& out) const
+    {
+        for (int cy = Cell(r.top); cy <= Cell(r.bottom); cy++) {
+            for (int cx = Cell(r.left); cx <= Cell(r.right); cx++) {
+                auto cell = grid.find(Pack(cx, cy));
+                if (cell != grid.end()) {
+                    out.insert(out.end(), cell->second.begin(), cell->second.end());
+                }
+            }
+        }
+        sort(out.begin(), out.end());
+        out.erase(unique(out.begin(), out.end()), out.end());
+    };
+
+    static double Overlap(const RECT& a, const RECT& b)
+    {
+        long w = min(a.right, b.right) - max(a.left, b.left);
+        long h = min(a.bottom, b.bottom) - max(a.top, b.top);
+        return (w > 0 && h > 0) ? (double)w * h : 0;
+    };
+
+    static int Cell(long v)
+    {
+        return (int)floor((double)v / TAG_GRID_CELL);
+    };
+
+    static long long Pack(int cx, int cy)
+    {
+        return ((long long)cy << 32) | (unsigned int)cx;
+    };
+
+    map<string, Placed> placed;
+    unordered_map<long long, vector<string>> grid;
+    vector<string> near;
+
+    unsigned int frame = 0;
+    int lastLeaderLen = -1;
+    int lastTagAngle = 0;
+};
@@ -0,0 +1,92 @@
+#include "pch.h"
+#include "TargetFilter.h"
+#include <climits>
+#include <cstdlib>
+
+vector<FilterBand> FilterRules::ParseBands(const char* text)
+{
+	vector<FilterBand> bands;
+
+	// pairs of numbers split by anything that isn't a digit
+	const char* c = text;
+	while (*c) {
+		while (*c && !isdigit((unsigned char)*c)) { c++; }
+		if (!*c) { break; }
+		int low = strtol(c, (char**)&c, 10);
+
+		while (*c && !isdigit((unsigned char)*c)) { c++; }
+		if (!*c) { break; }
+		int high = strtol(c, (char**)&c, 10);
+
+		bands.push_back({ low, high });
+	}
+
+	return bands;
+}
+
+string FilterRules::BandsText(const vector<FilterBand>& bands)
+{
+	string text;
+	for (const FilterBand& b : bands) {
+		char buf[16];
+		sprintf_s(buf, "%03d-%03d", b.low, b.high);
+		text += (text.empty() ? "" : ",") + string(buf);
+	}
+	return text;
+}
+
+void TargetFilter::Compile(const FilterRules& rules)
+{
+	program.clear();
+
+	if (!rules.on || rules.bands.empty()) {
+		program.push_back({ FOP_ALL, 0, 0 });
+	}
+	else {
+		for (const FilterBand& b : rules.bands) {
+			program.push_back({ FOP_BAND, b.low * 100, b.high > 0 ? b.high * 100 : INT_MAX });
+		}
+	}
+
+	if (rules.on && rules.vfrFloor > 0) {
+		program.push_back({ FOP_HIDE_BELOW, TF_VFR, rules.vfrFloor * 100 });
+	}
+
+	// the exceptions go last so nothing above can hide them
+	program.push_back({ FOP_KEEP, (rules.on ? rules.keep : 0) | TF_GROUND | TF_QUICKLOOK, 0 });
+}
+
+void TargetFilter::Run(const int* alt, const uint8_t* flags, size_t n, FrameVector<uint64_t>& mask) const
+{
+	FrameVector<uint8_t> vis(n, 0);
+
+	for (const FilterOp& op : program) {
+		switch (op.op) {
+		case FOP_ALL:
+			for (size_t i = 0; i < n; i++) {
+				vis[i] = 1;
+			}
+			break;
+		case FOP_BAND:
+			for (size_t i = 0; i < n; i++) {
+				vis[i] |= (uint8_t)((alt[i] >= op.a) & (alt[i] <= op.b));
+			}
+			break;
+		case FOP_HIDE_BELOW:
+			for (size_t i = 0; i < n; i++) {
+				vis[i] &= (uint8_t)(((flags[i] & op.a) == 0) | (alt[i] >= op.b));
+			}
+			break;
+		case FOP_KEEP:
+			for (size_t i = 0; i < n; i++) {
+				vis[i] |= (uint8_t)((flags[i] & op.a) != 0);
+			}
+			break;
+		}
+	}
+
+	mask.assign((n + 63) / 64, 0);
+	for (size_t i = 0; i < n; i++) {
+		mask[i >> 6] |= (uint64_t)vis[i] << (i & 63);
+	}
+}
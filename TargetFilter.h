@@ -0,0 +1,70 @@
+#pragma once
+#include "FrameArena.h"
+#include <vector>
+#include <string>
+#include <cstdint>
+
+using namespace std;
+
+// what a target is, for the filter exceptions; bits
+const int TF_OWNED = 1;
+const int TF_EMERGENCY = 2;
+const int TF_HALOED = 4;
+const int TF_VFR = 8;
+const int TF_GROUND = 16; // ground mode target, always shown
+const int TF_QUICKLOOK = 32; // tracked by a position under quick look, always shown
+
+// what the Keep button turns on; off unless asked for, so the filter hides what it always did
+const int TF_KEEP_ALL = TF_OWNED | TF_EMERGENCY | TF_HALOED;
+
+// altitude band in FL, inclusive; a high of 0 has no upper limit
+struct FilterBand {
+    int low;
+    int high;
+};
+
+// the altitude filter as set up from the menu
+struct FilterRules {
+    bool on = true;
+    vector<FilterBand> bands; // shown when in any of them; none shows every altitude
+    int keep = 0; // shown whatever the bands and the VFR floor
+    int vfrFloor = 0; // FL, VFR below it are hidden; 0 is off
+
+    // "000-180,250-000" and back, for the menu field and the ASR
+    static vector<FilterBand> ParseBands(const char* text);
+    static string BandsText(const vector<FilterBand>& bands);
+};
+
+// filter instructions
+const int FOP_ALL = 0; // show everything
+const int FOP_BAND = 1; // show when a <= alt <= b
+const int FOP_HIDE_BELOW = 2; // hide targets with any of the flags a when alt < b
+const int FOP_KEEP = 3; // show targets with any of the flags a
+
+struct FilterOp {
+    int op;
+    int a;
+    int b;
+};
+
+// The altitude filter compiled into a short list of instructions when the settings
+// change, instead of the rules being worked through per target every frame. Run takes
+// the frame's targets as an altitude array and a flags array and does one tight pass
+// per instruction over all of them, leaving a bit per target in the visibility mask
+class TargetFilter
+{
+public:
+    void Compile(const FilterRules& rules);
+
+    void Run(const int* alt, const uint8_t* flags, size_t n, FrameVector<uint64_t>& mask) const;
+
+    static bool Visible(const FrameVector<uint64_t>& mask, size_t i)
+    {
+        return (mask[i >> 6] >> (i & 63)) & 1;
+    };
+
+    const vector<FilterOp>& Program() const { return program; };
+
+protected:
+    vector<FilterOp> program;
+};
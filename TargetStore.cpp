@@ -0,0 +1,272 @@
+#include "pch.h"
+#include "TargetStore.h"
+#include <regex>
+
+TargetStore::TargetStore()
+{
+	snap = make_shared<const TargetMap>();
+}
+
+TargetStore::~TargetStore()
+{
+}
+
+const TargetData& TargetStore::UpdatePosition(CRadarTarget RadarTarget)
+{
+	TargetData& td = targets[RadarTarget.GetCallsign()];
+
+	CPosition pos = RadarTarget.GetPosition().GetPosition();
+	int alt = RadarTarget.GetPosition().GetPressureAltitude();
+
+	// when the report was received, seconds
+	double t = GetTickCount64() / 1000.0 - RadarTarget.GetPosition().GetReceivedTime();
+
+	// the same report again is a no-op, but a target reporting the same place a sweep later
+	// has stopped and the filter still needs to hear it, or it would keep its old velocity
+	bool moved = td.version == 0 || pos.m_Latitude != td.pos.m_Latitude || pos.m_Longitude != td.pos.m_Longitude || alt != td.alt;
+	if (!moved && t - td.reportT < TRACK_MIN_DT) {
+		return td; // already have this one
+	}
+	td.reportT = t;
+
+	if (moved) {
+		trails.Append(RadarTarget.GetCallsign(), pos);
+	}
+
+	td.pos = pos;
+	td.alt = alt;
+
+	if (td.slot < 0) {
+		// new target, the filter starts from what ES says and the rest is known straight away
+		td.slot = filter.Add();
+		if (td.slot >= (int)slotCallsigns.size()) {
+			slotCallsigns.resize(td.slot + 1);
+		}
+		slotCallsigns[td.slot] = RadarTarget.GetCallsign();
+
+		td.fpos = pos;
+		td.gs = RadarTarget.GetGS();
+		td.trk = RadarTarget.GetTrackHeading();
+		td.vs = RadarTarget.GetVerticalSpeed();
+		filter.Seed(td.slot, pos.m_Latitude, pos.m_Longitude, alt, t, td.gs, td.trk, td.vs);
+		ResolvePosition(td);
+	}
+	else {
+		// the rest of the sweep is filtered together on the next Flush
+		filter.Queue(td.slot, pos.m_Latitude, pos.m_Longitude, alt, t);
+	}
+
+	// first sight of the target, or it has only just correlated
+	CFlightPlan fp = RadarTarget.GetCorrelatedFlightPlan();
+	if (!td.classified && fp.IsValid()) {
+		Classify(fp, td);
+	}
+
+	// assuming and releasing a track, and handoffs, don't come with a callback of their
+	// own, so the owner and handoff target are checked on every report
+	bool tracking = owners.Set(td.slot, fp.IsValid() ? fp.GetTrackingControllerId() : "");
+	const char* handoff = fp.IsValid() ? fp.GetHandoffTargetControllerId() : "";
+	if (td.slot >= (int)slotHandoffs.size()) {
+		slotHandoffs.resize(td.slot + 1);
+	}
+	if (slotHandoffs[td.slot] != handoff) {
+		slotHandoffs[td.slot] = handoff;
+		tracking = true;
+	}
+	if (tracking) {
+		trackingChanged.push_back(RadarTarget.GetCallsign());
+	}
+
+	// an unchanged report only moves the filter, and Flush bumps the version for that
+	if (moved) {
+		td.version = ++version;
+	}
+
+	return td;
+}
+
+void TargetStore::UpdateFlightPlan(CFlightPlan FlightPlan)
+{
+	auto td = targets.find(FlightPlan.GetCallsign());
+	if (td == targets.end()) {
+		return; // classified when the target first shows up
+	}
+
+	Classify(FlightPlan, td->second);
+	owners.Set(td->second.slot, FlightPlan.GetTrackingControllerId());
+	td->second.version = ++version;
+}
+
+void TargetStore::UpdateOwner(CFlightPlan FlightPlan)
+{
+	auto td = targets.find(FlightPlan.GetCallsign());
+	if (td != targets.end()) {
+		owners.Set(td->second.slot, FlightPlan.GetTrackingControllerId());
+	}
+}
+
+void TargetStore::ReleaseOwner(const string& position)
+{
+	owners.Release(position);
+}
+
+void TargetStore::Remove(const string& callsign)
+{
+	trails.Remove(callsign);
+
+	auto td = targets.find(callsign);
+	if (td != targets.end()) {
+		owners.Clear(td->second.slot);
+		if (td->second.slot >= 0 && td->second.slot < (int)slotHandoffs.size()) {
+			slotHandoffs[td->second.slot].clear();
+		}
+		filter.Free(td->second.slot);
+		targets.erase(td);
+		version++;
+	}
+}
+
+void TargetStore::Expired(vector<string>& out) const
+{
+	double now = GetTickCount64() / 1000.0;
+
+	for (auto& td : targets) {
+		if (now - td.second.reportT > TARGET_EXPIRE_SEC) {
+			out.push_back(td.first);
+		}
+	}
+}
+
+void TargetStore::Flush()
+{
+	if (!filter.Pending()) {
+		return;
+	}
+
+	filter.Run();
+
+	for (int slot : filter.Updated()) {
+		auto it = targets.find(slotCallsigns[slot]);
+		if (it == targets.end()) {
+			continue;
+		}
+
+		TargetData& td = it->second;
+		td.fpos.m_Latitude = filter.Lat(slot);
+		td.fpos.m_Longitude = filter.Lon(slot);
+		td.trk = filter.Trk(slot);
+		td.gs = (int)lround(filter.Gs(slot));
+		td.vs = (int)lround(filter.Vs(slot));
+		ResolvePosition(td);
+		td.version = ++version;
+	}
+}
+
+shared_ptr<const TargetMap> TargetStore::Snapshot()
+{
+	Flush();
+
+	if (snapVersion != version) {
+		snap = make_shared<const TargetMap>(targets);
+		snapVersion = version;
+	}
+
+	return snap;
+}
+
+void TargetStore::SetAirports(const AirportIndex* index)
+{
+	airports = index;
+
+	for (auto& td : targets) {
+		ResolveAirports(td.second);
+		ResolvePosition(td.second);
+		td.second.version = ++version;
+	}
+}
+
+void TargetStore::SetSurface(const SurfaceIndex* index)
+{
+	surface = index;
+
+	for (auto& td : targets) {
+		td.second.segment = -1;
+		td.second.segmentPos = CPosition();
+		ResolvePosition(td.second);
+		td.second.version = ++version;
+	}
+}
+
+void TargetStore::SetAirspace(const AirspaceIndex* index)
+{
+	airspace = index;
+
+	for (auto& td : targets) {
+		ResolvePosition(td.second);
+		td.second.version = ++version;
+	}
+}
+
+void TargetStore::ResolvePosition(TargetData& td)
+{
+	int airport = -1;
+	if (airports != nullptr && td.gs <= TARGET_GND_MAX_GS) {
+		airport = airports->Nearest(td.pos, TARGET_GND_MAX_NM);
+	}
+
+	// the segment is only looked up again once the target has moved a few metres,
+	// so targets holding or creeping along don't go back to the grid every update
+	if (surface == nullptr || airport < 0) {
+		td.segment = -1;
+	}
+	else if (airport != td.airport || SurfaceIndex::Moved(td.segmentPos, td.pos, SURF_RELOOKUP_M)) {
+		td.segment = surface->Find(airport, td.pos);
+		td.segmentPos = td.pos;
+	}
+
+	td.airport = airport;
+
+	// entry and exit, so the screens only compare numbers each frame
+	if (airspace != nullptr) {
+		airspace->Predict(td.fpos, td.trk, td.gs, td.alt, td.vs, td.entrySec, td.exitSec);
+	}
+	else {
+		td.entrySec = -1;
+		td.exitSec = -1;
+	}
+}
+
+void TargetStore::ResolveAirports(TargetData& td)
+{
+	// looked up once here so the ground display compares indices rather than strings
+	td.originApt = airports != nullptr ? airports->Find(td.origin) : -1;
+	td.destApt = airports != nullptr ? airports->Find(td.dest) : -1;
+}
+
+void TargetStore::Classify(CFlightPlan FlightPlan, TargetData& td)
+{
+	// aircraft equipment parsing; the patterns are only built once
+	static const regex icaoRVSM("(.*)\\/(.*)\\-(.*)[W](.*)\\/(.*)", regex::icase);
+	static const regex icaoADSB("(.*)\\/(.*)\\-(.*)\\/(.*)(E|L|B1|B2|U1|U2|V1|V2)(.*)");
+
+	string acInfo = FlightPlan.GetFlightPlanData().GetAircraftInfo();
+	if (acInfo != td.acInfo || !td.classified) {
+		td.acInfo = acInfo;
+		td.isRVSM = regex_search(acInfo, icaoRVSM);
+		td.isADSB = regex_search(acInfo, icaoADSB);
+	}
+
+	td.capability = FlightPlan.GetFlightPlanData().GetCapibilities();
+	td.planType = FlightPlan.GetFlightPlanData().GetPlanType()[0];
+	td.acType = FlightPlan.GetFlightPlanData().GetAircraftFPType();
+
+	td.clearedAlt = FlightPlan.GetControllerAssignedData().GetClearedAltitude();
+	if (td.clearedAlt == 0) {
+		td.clearedAlt = FlightPlan.GetFinalAltitude();
+	}
+
+	td.origin = FlightPlan.GetFlightPlanData().GetOrigin();
+	td.dest = FlightPlan.GetFlightPlanData().GetDestination();
+	ResolveAirports(td);
+	td.classified = true;
+}
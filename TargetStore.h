@@ -0,0 +1,139 @@
+#pragma once
+#include "EuroScopePlugIn.h"
+#include "AirportIndex.h"
+#include "SurfaceIndex.h"
+#include "AirspaceIndex.h"
+#include "HistoryTrails.h"
+#include "TrackFilter.h"
+#include "OwnerIndex.h"
+#include <string>
+#include <map>
+#include <memory>
+
+using namespace std;
+using namespace EuroScopePlugIn;
+
+// targets slower than this are matched to the aerodrome they are at
+const int TARGET_GND_MAX_GS = 80;
+const double TARGET_GND_MAX_NM = 3;
+
+// a target not heard from for this long, seconds, is dropped; uncorrelated targets have
+// no disconnect callback, so this is the only way they go
+const double TARGET_EXPIRE_SEC = 60;
+
+// Per target values cached when a radar target or its flight plan updates, so the
+// drawing loops and the conflict probes read them instead of going back to the SDK
+struct TargetData {
+    CPosition pos; // as reported, where the target is drawn
+    CPosition fpos; // smoothed by the track filter, what the predictions start from
+    double trk = 0; // track, speed and rate are the filter's estimates
+    int gs = 0;
+    int alt = 0; // pressure altitude, ft
+    int vs = 0; // ft/min
+    int slot = -1; // in the track filter
+    double reportT = 0; // when the last report fed to the filter was received, seconds
+
+    // flight plan classification, only redone when the flight plan changes
+    string acInfo;
+    char capability = 0;
+    char planType = 0;
+    string acType;
+    int clearedAlt = 0; // cleared, or the final altitude if none; 1 and 2 are ILS and visual approach
+    string origin;
+    string dest;
+
+    // indices in the airport index, -1 if none
+    int originApt = -1;
+    int destApt = -1;
+    int airport = -1; // the aerodrome a slow target is at
+    int segment = -1; // runway or ground layout segment it is on, in the surface index
+    CPosition segmentPos; // where the segment was last looked up
+
+    // seconds until entering and leaving the selected airspace, -1 if not soon
+    int entrySec = -1;
+    int exitSec = -1;
+    bool isRVSM = false; // ICAO equipment contains W
+    bool isADSB = false;
+    bool classified = false;
+
+    unsigned int version = 0; // store version when this target last changed
+};
+
+typedef map<string, TargetData> TargetMap;
+
+// One store for the whole plugin, fed from the SDK callbacks on the UI thread. Every
+// radar screen reads the same data, so a target is only classified once however many
+// screens are open. Snapshot hands out an immutable copy, rebuilt at most once per
+// version, for the background tasks; the screens read the store directly on the UI thread.
+class TargetStore
+{
+public:
+    TargetStore(void);
+    ~TargetStore(void);
+
+    // safe to call more than once for the same update; whichever of the plugin or a
+    // screen hears about it first feeds the store and the rest are no-ops
+    const TargetData& UpdatePosition(CRadarTarget RadarTarget);
+    void UpdateFlightPlan(CFlightPlan FlightPlan);
+    void UpdateOwner(CFlightPlan FlightPlan); // tracking controller only, cheaper than UpdateFlightPlan
+    void ReleaseOwner(const string& position);
+    void Remove(const string& callsign);
+
+    // callsigns of the targets not heard from in TARGET_EXPIRE_SEC; the plugin drops them
+    // the same way as a disconnect, so every screen and the probes forget them too
+    void Expired(vector<string>& out) const;
+
+    // callsigns whose tracking controller or handoff target changed since the last call
+    bool TrackingChanged() const { return !trackingChanged.empty(); };
+    void TakeTrackingChanges(vector<string>& out) { out.swap(trackingChanged); trackingChanged.clear(); };
+
+    const TargetData* Find(const string& callsign) const
+    {
+        auto td = targets.find(callsign);
+        return td == targets.end() ? nullptr : &td->second;
+    };
+
+    const TargetMap& Targets() const { return targets; };
+    const HistoryTrails& Trails() const { return trails; };
+    const TrackFilter& Filter() const { return filter; };
+    const OwnerIndex& Owners() const { return owners; };
+    unsigned int Version() const { return version; };
+
+    // runs the track filter over the positions queued since the last call
+    void Flush();
+
+    // flushes first, so the copy always has the filtered state
+    shared_ptr<const TargetMap> Snapshot();
+
+    // aerodromes to match targets to; re-resolves every target when it changes
+    void SetAirports(const AirportIndex* index);
+
+    // runways and ground layout to find the segment a ground target is on
+    void SetSurface(const SurfaceIndex* index);
+
+    // airspace to predict entry and exit against; call again after the selection changes
+    void SetAirspace(const AirspaceIndex* index);
+
+protected:
+    void Classify(CFlightPlan FlightPlan, TargetData& td);
+    void ResolveAirports(TargetData& td);
+    void ResolvePosition(TargetData& td);
+
+    const AirportIndex* airports = nullptr;
+    const SurfaceIndex* surface = nullptr;
+    const AirspaceIndex* airspace = nullptr;
+
+    TargetMap targets;
+    unsigned int version = 0;
+
+    // kept out of TargetData so the snapshots don't copy them
+    HistoryTrails trails;
+    TrackFilter filter;
+    vector<string> slotCallsigns;
+    OwnerIndex owners; // by track filter slot
+    vector<string> slotHandoffs; // handoff target controller by slot, empty if none
+    vector<string> trackingChanged;
+
+    shared_ptr<const TargetMap> snap;
+    unsigned int snapVersion = 0;
+};
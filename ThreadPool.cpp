@@ -0,0 +1,168 @@
+#include "pch.h"
+#include "ThreadPool.h"
+
+thread_local int ThreadPool::workerIndex = -1;
+thread::id ThreadPool::uiThread;
+
+ThreadPool::ThreadPool()
+{
+	queued = 0;
+	stopping = false;
+	nextQueue = 0;
+}
+
+ThreadPool::~ThreadPool()
+{
+	Stop();
+}
+
+void ThreadPool::Start(int numThreads)
+{
+	if (!threads.empty()) {
+		return;
+	}
+
+	uiThread = this_thread::get_id();
+
+	if (numThreads <= 0) {
+		numThreads = max((int)thread::hardware_concurrency() - 1, 1);
+	}
+
+	stopping = false;
+
+	for (int i = 0; i < numThreads; i++) {
+		queues.push_back(unique_ptr<TaskQueue>(new TaskQueue()));
+	}
+	for (int i = 0; i < numThreads; i++) {
+		threads.push_back(thread(&ThreadPool::WorkerLoop, this, i));
+	}
+}
+
+void ThreadPool::Stop()
+{
+	{
+		lock_guard<mutex> lock(sleepMutex);
+		stopping = true;
+	}
+	sleepCv.notify_all();
+
+	for (thread& t : threads) {
+		if (t.joinable()) {
+			t.join();
+		}
+	}
+
+	// anything not started or not handed back yet is dropped
+	threads.clear();
+	queues.clear();
+	queued = 0;
+	completions.Clear();
+}
+
+void ThreadPool::DrainCompletions()
+{
+	ASSERT_UI_THREAD();
+
+	completions.Drain();
+}
+
+bool ThreadPool::IsUIThread()
+{
+	// before the pool starts everything is on the UI thread
+	return workerIndex < 0 && (uiThread == thread::id() || this_thread::get_id() == uiThread);
+}
+
+void ThreadPool::Submit(function<void()> task)
+{
+	if (queues.empty()) {
+		task(); // not started, run in place
+		return;
+	}
+
+	int q = workerIndex >= 0 ? workerIndex : (int)(nextQueue++ % queues.size());
+	{
+		lock_guard<mutex> lock(queues[q]->m);
+		queues[q]->tasks.push_back(move(task));
+	}
+
+	// counted under the sleep lock, so a worker can't check the count and then miss the wakeup
+	{
+		lock_guard<mutex> lock(sleepMutex);
+		queued++;
+	}
+	sleepCv.notify_one();
+}
+
+bool ThreadPool::RunOne(int self)
+{
+	function<void()> task;
+	int n = (int)queues.size();
+
+	// own work first, newest first while it is still warm in the cache
+	if (self >= 0) {
+		lock_guard<mutex> lock(queues[self]->m);
+		if (!queues[self]->tasks.empty()) {
+			task = move(queues[self]->tasks.back());
+			queues[self]->tasks.pop_back();
+		}
+	}
+
+	// then steal the oldest task of another worker
+	for (int k = 1; !task && k <= n; k++) {
+		int victim = ((self < 0 ? 0 : self) + k) % n;
+
+		lock_guard<mutex> lock(queues[victim]->m);
+		if (!queues[victim]->tasks.empty()) {
+			task = move(queues[victim]->tasks.front());
+			queues[victim]->tasks.pop_front();
+		}
+	}
+
+	if (!task) {
+		return false;
+	}
+
+	queued--;
+	task();
+
+	return true;
+}
+
+void ThreadPool::WorkerLoop(int idx)
+{
+	workerIndex = idx;
+
+	while (!stopping) {
+		if (!RunOne(idx)) {
+			unique_lock<mutex> lock(sleepMutex);
+			sleepCv.wait(lock, [this] { return stopping || queued > 0; });
+		}
+	}
+
+	workerIndex = -1;
+}
+
+void ThreadPool::ParallelFor(int n, const function<void(int)>& fn)
+{
+	if (queues.empty()) {
+		for (int i = 0; i < n; i++) {
+			fn(i);
+		}
+		return;
+	}
+
+	atomic<int> remaining(n);
+
+	for (int i = 0; i < n; i++) {
+		Submit([&fn, &remaining, i] {
+			fn(i);
+			remaining--;
+		});
+	}
+
+	while (remaining > 0) {
+		if (!RunOne(workerIndex)) {
+			this_thread::yield();
+		}
+	}
+}
@@ -0,0 +1,75 @@
+#pragma once
+#include <vector>
+#include <deque>
+#include <memory>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include "CompletionQueue.h"
+
+using namespace std;
+
+// EuroScope only ever calls the plugin on its UI thread and the SDK is not thread safe,
+// so anything that touches it checks it is not running on a pool thread
+#define ASSERT_UI_THREAD() ASSERT(ThreadPool::IsUIThread())
+
+// Small work stealing pool shared by the whole plugin. Each worker has its own deque:
+// it pushes and pops its own work at the back and steals from the front of the
+// others when it runs dry. Work submitted from outside the pool is spread round
+// robin over the deques. Tasks hand results back through Complete, which runs
+// them on the UI thread the next time it drains the completion queue.
+class ThreadPool
+{
+public:
+    ThreadPool(void);
+    ~ThreadPool(void);
+
+    // numThreads 0 = one less than the cores, so the UI thread keeps a core to itself
+    void Start(int numThreads = 0);
+    void Stop();
+
+    void Submit(function<void()> task);
+
+    // runs fn(0) .. fn(n - 1) across the pool and returns when all are done;
+    // the calling thread works through tasks while it waits, so it is safe from inside a task
+    void ParallelFor(int n, const function<void(int)>& fn);
+
+    // any thread: queue fn to run on the UI thread
+    void Complete(function<void()> fn) { completions.Post(move(fn)); };
+
+    // UI thread: run the completed results, at the start of OnRefresh and OnTimer
+    void DrainCompletions();
+
+    int NumThreads() const { return (int)threads.size(); };
+
+    static bool IsUIThread();
+
+protected:
+    struct TaskQueue {
+        mutex m;
+        deque<function<void()>> tasks;
+    };
+
+    bool RunOne(int self);
+    void WorkerLoop(int idx);
+
+    vector<unique_ptr<TaskQueue>> queues;
+    vector<thread> threads;
+
+    atomic<int> queued; // tasks waiting in the deques; only raised under sleepMutex
+    atomic<bool> stopping;
+    atomic<unsigned int> nextQueue;
+
+    mutex sleepMutex;
+    condition_variable sleepCv;
+
+    CompletionQueue completions;
+
+    // the thread that started the pool
+    static thread::id uiThread;
+
+    // index of the worker running on this thread, -1 off the pool
+    static thread_local int workerIndex;
+};
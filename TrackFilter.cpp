@@ -0,0 +1,151 @@
+#include "pch.h"
+#include "TrackFilter.h"
+#include "Geodesy.h"
+#include <algorithm>
+
+int TrackFilter::Add()
+{
+	if (!freeSlots.empty()) {
+		int slot = freeSlots.back();
+		freeSlots.pop_back();
+		return slot;
+	}
+
+	int slot = (int)lat.size();
+	for (vector<double>* v : { &lat, &lon, &alt, &ve, &vn, &vz, &t }) {
+		v->push_back(0);
+	}
+	pendingAt.push_back(-1);
+	return slot;
+}
+
+void TrackFilter::Free(int slot)
+{
+	// a queued report for it is dropped, the slot may be handed out again before Run
+	if (pendingAt[slot] >= 0) {
+		mSlot[pendingAt[slot]] = -1;
+		pendingAt[slot] = -1;
+	}
+	freeSlots.push_back(slot);
+}
+
+void TrackFilter::Seed(int slot, double la, double lo, double al, double time, double gs, double trk, double vs)
+{
+	lat[slot] = la;
+	lon[slot] = lo;
+	alt[slot] = al;
+	t[slot] = time;
+	ve[slot] = gs / 3600.0 * sin(Geodesy::ToRad(trk));
+	vn[slot] = gs / 3600.0 * cos(Geodesy::ToRad(trk));
+	vz[slot] = vs / 60.0;
+}
+
+void TrackFilter::Queue(int slot, double la, double lo, double al, double time)
+{
+	int q = pendingAt[slot];
+	if (q < 0) {
+		q = (int)mSlot.size();
+		pendingAt[slot] = q;
+		mSlot.push_back(slot);
+		mLat.push_back(0);
+		mLon.push_back(0);
+		mAlt.push_back(0);
+		mT.push_back(0);
+	}
+
+	mLat[q] = la;
+	mLon[q] = lo;
+	mAlt[q] = al;
+	mT[q] = time;
+}
+
+void TrackFilter::Run()
+{
+	updated.clear();
+	size_t n = mSlot.size();
+
+	// gather
+	bLat.resize(n); bLon.resize(n); bAlt.resize(n);
+	bVe.resize(n); bVn.resize(n); bVz.resize(n); bT.resize(n);
+	for (size_t i = 0; i < n; i++) {
+		int s = max(mSlot[i], 0); // a freed entry runs on slot 0 and is thrown away
+		bLat[i] = lat[s];
+		bLon[i] = lon[s];
+		bAlt[i] = alt[s];
+		bVe[i] = ve[s];
+		bVn[i] = vn[s];
+		bVz[i] = vz[s];
+		bT[i] = t[s];
+	}
+
+	// predict to the report time and correct; a stale or out of order report just
+	// resets the position and keeps the velocity
+	const double degToRad = PI / 180.0;
+	for (size_t i = 0; i < n; i++) {
+		double dt = mT[i] - bT[i];
+		bool ok = dt > 0 && dt <= TRACK_MAX_GAP;
+		double step = ok ? dt : 1;
+
+		double nmPerDegLon = 60.0 * cos(bLat[i] * degToRad);
+		double pLat = bLat[i] + bVn[i] * step / 60.0;
+		double pLon = bLon[i] + bVe[i] * step / nmPerDegLon;
+		double pAlt = bAlt[i] + bVz[i] * step;
+
+		double rn = (mLat[i] - pLat) * 60.0;
+		double re = (mLon[i] - pLon) * nmPerDegLon;
+		double ra = mAlt[i] - pAlt;
+
+		bLat[i] = ok ? pLat + TRACK_ALPHA * rn / 60.0 : mLat[i];
+		bLon[i] = ok ? pLon + TRACK_ALPHA * re / nmPerDegLon : mLon[i];
+		bAlt[i] = ok ? pAlt + TRACK_ALT_ALPHA * ra : mAlt[i];
+		bVn[i] = ok ? bVn[i] + TRACK_BETA * rn / step : bVn[i];
+		bVe[i] = ok ? bVe[i] + TRACK_BETA * re / step : bVe[i];
+		bVz[i] = ok ? bVz[i] + TRACK_ALT_BETA * ra / step : bVz[i];
+		bT[i] = mT[i];
+	}
+
+	// scatter
+	for (size_t i = 0; i < n; i++) {
+		int s = mSlot[i];
+		if (s < 0) {
+			continue; // freed since it was queued
+		}
+		lat[s] = bLat[i];
+		lon[s] = bLon[i];
+		alt[s] = bAlt[i];
+		ve[s] = bVe[i];
+		vn[s] = bVn[i];
+		vz[s] = bVz[i];
+		t[s] = bT[i];
+		pendingAt[s] = -1;
+		updated.push_back(s);
+	}
+
+	mSlot.clear();
+	mLat.clear();
+	mLon.clear();
+	mAlt.clear();
+	mT.clear();
+}
+
+void TrackFilter::Extrapolate(const int* slots, size_t n, double now, CPosition* out) const
+{
+	const double degToRad = PI / 180.0;
+
+	for (size_t i = 0; i < n; i++) {
+		int s = slots[i];
+		double dt = min(max(now - t[s], 0.0), TRACK_MAX_XTRAP);
+		out[i].m_Latitude = lat[s] + vn[s] * dt / 60.0;
+		out[i].m_Longitude = lon[s] + ve[s] * dt / (60.0 * cos(lat[s] * degToRad));
+	}
+}
+
+double TrackFilter::Gs(int slot) const
+{
+	return sqrt(ve[slot] * ve[slot] + vn[slot] * vn[slot]) * 3600.0;
+}
+
+double TrackFilter::Trk(int slot) const
+{
+	return fmod(Geodesy::ToDeg(atan2(ve[slot], vn[slot])) + 360.0, 360.0);
+}
@@ -0,0 +1,71 @@
+#pragma once
+#include "EuroScopePlugIn.h"
+#include <vector>
+
+using namespace std;
+using namespace EuroScopePlugIn;
+
+// alpha-beta gains for position and altitude; lower follows the reports less closely
+const double TRACK_ALPHA = 0.5;
+const double TRACK_BETA = 0.2;
+const double TRACK_ALT_ALPHA = 0.5;
+const double TRACK_ALT_BETA = 0.1;
+
+// a gap longer than this, seconds, starts the filter again from the report
+const double TRACK_MAX_GAP = 30;
+
+// reports closer together than this, seconds, are the same one heard twice
+const double TRACK_MIN_DT = 2;
+
+// a target that has missed reports is only moved on this far, seconds, from its last one
+const double TRACK_MAX_XTRAP = 10;
+
+// Alpha-beta tracker for every target, smoothing position and estimating velocity and
+// vertical rate from the raw reports. State is kept as one array per field, indexed by
+// slot. Reports are queued as they arrive and Run updates the whole sweep at once:
+// the states are gathered into contiguous arrays, one branch free loop does the maths,
+// and the results are scattered back.
+class TrackFilter
+{
+public:
+    int Add();
+    void Free(int slot);
+
+    // first report, velocity seeded from what ES says until the filter has its own
+    void Seed(int slot, double lat, double lon, double alt, double t, double gs, double trk, double vs);
+
+    // a later report; a second one for the same slot before Run replaces the first
+    void Queue(int slot, double lat, double lon, double alt, double t);
+
+    // updates every queued slot
+    void Run();
+    bool Pending() const { return !mSlot.empty(); };
+    const vector<int>& Updated() const { return updated; };
+
+    double Lat(int slot) const { return lat[slot]; };
+    double Lon(int slot) const { return lon[slot]; };
+    double Alt(int slot) const { return alt[slot]; };
+    double Gs(int slot) const; // kts
+    double Trk(int slot) const; // degrees true
+    double Vs(int slot) const { return vz[slot] * 60.0; }; // ft/min
+    int Slots() const { return (int)lat.size(); };
+
+    // where each of the n slots is at time now, straight on from its filtered state; out
+    // is parallel to slots. One pass over the batch, for drawing between the reports
+    void Extrapolate(const int* slots, size_t n, double now, CPosition* out) const;
+
+protected:
+    // state by slot; velocities in NM/s east and north, vertical rate in ft/s
+    vector<double> lat, lon, alt, ve, vn, vz, t;
+    vector<int> pendingAt; // index in the queue, -1 if none
+    vector<int> freeSlots;
+
+    // reports queued since the last Run
+    vector<int> mSlot;
+    vector<double> mLat, mLon, mAlt, mT;
+
+    // gathered batch
+    vector<double> bLat, bLon, bAlt, bVe, bVn, bVz, bT;
+
+    vector<int> updated;
+};
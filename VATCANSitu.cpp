@@ -54,10 +54,15 @@ void __declspec (dllexport) EuroScopePlugInInit(EuroScopePlugIn::CPlugIn** ppPlu
 	GdiplusStartup(&m_gdiplusToken, &gdiplusStartupInput, nullptr);
 	
 	*ppPlugInInstance = gpMyPlugIn = new SituPlugin();
+
+	gpMyPlugIn->StartWorkers();
 }
 
 void __declspec (dllexport) EuroScopePlugInExit(void)
 {
+	// join the workers before anything they reference goes away
+	gpMyPlugIn->StopWorkers();
+
 	delete gpMyPlugIn;
 }
 
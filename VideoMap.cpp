@@ -0,0 +1,156 @@
+#include "pch.h"
+#include "VideoMap.h"
+#include "LineSimplify.h"
+#include "Geodesy.h"
+#include <algorithm>
+
+// a vertex in NM on a flat projection around its own line, for the simplification
+struct VideoMapVertex {
+    double x;
+    double y;
+    int32_t lat;
+    int32_t lon;
+};
+
+VideoMap::VideoMap()
+{
+}
+
+VideoMap::~VideoMap()
+{
+}
+
+void VideoMapData::Build(const SectorGeometry& geo)
+{
+	static const int layerTypes[VMAP_LAYERS][3] = {
+		{ SECTOR_ELEMENT_ARTC, SECTOR_ELEMENT_HIGH_ARTC, SECTOR_ELEMENT_LOW_ARTC },
+		{ SECTOR_ELEMENT_LOW_AIRWAY, SECTOR_ELEMENT_HIGH_AIRWAY, -1 },
+		{ SECTOR_ELEMENT_GEO, -1, -1 }
+	};
+
+	vector<VideoMapVertex> line;
+	vector<VideoMapVertex> kept;
+
+	// simplify one polyline into every level
+	auto flush = [&](int layer) {
+		if (line.size() < 2) {
+			line.clear();
+			return;
+		}
+
+		for (int lod = 0; lod < VMAP_LODS; lod++) {
+			kept.clear();
+			if (lod == 0) {
+				kept = line;
+			}
+			else {
+				LineSimplify::DouglasPeucker(line, VMAP_LOD_TOL_NM[lod], kept);
+			}
+
+			VideoMapLod& out = lods[layer][lod];
+			int32_t box[4] = { INT32_MAX, INT32_MAX, INT32_MIN, INT32_MIN };
+			for (const VideoMapVertex& v : kept) {
+				out.coords.push_back(v.lat);
+				out.coords.push_back(v.lon);
+				box[0] = min(box[0], v.lat);
+				box[1] = min(box[1], v.lon);
+				box[2] = max(box[2], v.lat);
+				box[3] = max(box[3], v.lon);
+			}
+			out.counts.push_back((uint32_t)kept.size());
+			out.boxes.insert(out.boxes.end(), box, box + 4);
+		}
+		line.clear();
+	};
+
+	for (int layer = 0; layer < VMAP_LAYERS; layer++) {
+		for (int t = 0; t < 3 && layerTypes[layer][t] >= 0; t++) {
+			for (int el : geo.OfType(layerTypes[layer][t])) {
+				double cosLat = cos(Geodesy::ToRad(geo.PointCount(el) > 0 ? geo.Point(el, 0).m_Latitude : 0));
+
+				// the elements are start and end pairs; runs where one segment starts at the
+				// end of the last are joined into a single polyline before simplifying
+				for (int i = 0; i + 1 < geo.PointCount(el); i += 2) {
+					CPosition a = geo.Point(el, i);
+					CPosition b = geo.Point(el, i + 1);
+
+					VideoMapVertex va = { a.m_Longitude * 60 * cosLat, a.m_Latitude * 60,
+						(int32_t)lround(a.m_Latitude * VMAP_UNITS), (int32_t)lround(a.m_Longitude * VMAP_UNITS) };
+					VideoMapVertex vb = { b.m_Longitude * 60 * cosLat, b.m_Latitude * 60,
+						(int32_t)lround(b.m_Latitude * VMAP_UNITS), (int32_t)lround(b.m_Longitude * VMAP_UNITS) };
+
+					if (line.empty() || line.back().lat != va.lat || line.back().lon != va.lon) {
+						flush(layer);
+						line.push_back(va);
+					}
+					line.push_back(vb);
+				}
+				flush(layer);
+			}
+		}
+	}
+}
+
+bool VideoMap::CacheStale(CRadarScreen* radscr, const VideoMapCache& cache, const VideoMapData* data, int layers)
+{
+	CPosition ll, ur;
+	radscr->GetDisplayArea(&ll, &ur);
+	RECT area = radscr->GetRadarArea();
+
+	return !cache.valid || cache.source != data || cache.layers != layers
+		|| ll.m_Latitude != cache.ll.m_Latitude || ll.m_Longitude != cache.ll.m_Longitude
+		|| ur.m_Latitude != cache.ur.m_Latitude || ur.m_Longitude != cache.ur.m_Longitude
+		|| area.left != cache.area.left || area.top != cache.area.top
+		|| area.right != cache.area.right || area.bottom != cache.area.bottom;
+}
+
+void VideoMap::BuildCache(CRadarScreen* radscr, const VideoMapData& data, int layers, VideoMapCache& cache)
+{
+	RECT area = radscr->GetRadarArea();
+	radscr->GetDisplayArea(&cache.ll, &cache.ur);
+	cache.area = area;
+	cache.layers = layers;
+	cache.source = &data;
+	cache.valid = true;
+
+	// level of detail from how many pixels a NM takes across the middle of the display
+	CPosition mid;
+	mid.m_Latitude = (cache.ll.m_Latitude + cache.ur.m_Latitude) / 2;
+	mid.m_Longitude = cache.ll.m_Longitude;
+	CPosition midRight = mid;
+	midRight.m_Longitude = cache.ur.m_Longitude;
+	double widthNM = Geodesy::DistanceNM(mid, midRight);
+	double pixPerNM = widthNM > 0 ? (area.right - area.left) / widthNM : 1;
+	int lod = VideoMapData::Lod(pixPerNM);
+
+	int32_t minLat = (int32_t)floor(min(cache.ll.m_Latitude, cache.ur.m_Latitude) * VMAP_UNITS);
+	int32_t maxLat = (int32_t)ceil(max(cache.ll.m_Latitude, cache.ur.m_Latitude) * VMAP_UNITS);
+	int32_t minLon = (int32_t)floor(min(cache.ll.m_Longitude, cache.ur.m_Longitude) * VMAP_UNITS);
+	int32_t maxLon = (int32_t)ceil(max(cache.ll.m_Longitude, cache.ur.m_Longitude) * VMAP_UNITS);
+
+	for (int l = 0; l < VMAP_LAYERS; l++) {
+		cache.pts[l].clear();
+		cache.counts[l].clear();
+		if (!(layers & (1 << l))) {
+			continue;
+		}
+
+		const VideoMapLod& src = data.lods[l][lod];
+		size_t c = 0;
+		for (size_t i = 0; i < src.counts.size(); i++) {
+			const int32_t* box = &src.boxes[i * 4];
+			uint32_t n = src.counts[i];
+
+			if (box[2] >= minLat && box[0] <= maxLat && box[3] >= minLon && box[1] <= maxLon) {
+				for (uint32_t k = 0; k < n; k++) {
+					CPosition pos;
+					pos.m_Latitude = (double)src.coords[(c + k) * 2] / VMAP_UNITS;
+					pos.m_Longitude = (double)src.coords[(c + k) * 2 + 1] / VMAP_UNITS;
+					cache.pts[l].push_back(radscr->ConvertCoordFromPositionToPixel(pos));
+				}
+				cache.counts[l].push_back(n);
+			}
+			c += n;
+		}
+	}
+}
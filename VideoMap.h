@@ -0,0 +1,99 @@
+#pragma once
+#include "EuroScopePlugIn.h"
+#include "SectorGeometry.h"
+#include <vector>
+#include <memory>
+#include <cstdint>
+
+using namespace std;
+using namespace EuroScopePlugIn;
+
+// map layers, bits in the layer mask saved to the ASR
+const int VMAP_BOUNDARIES = 0;
+const int VMAP_AIRWAYS = 1;
+const int VMAP_GEO = 2;
+const int VMAP_LAYERS = 3;
+
+// simplification tolerance of each level of detail; a level is drawn when its
+// tolerance is under VMAP_PIXEL_TOL on screen
+const int VMAP_LODS = 5;
+const double VMAP_LOD_TOL_NM[VMAP_LODS] = { 0, 0.05, 0.25, 1, 4 };
+const double VMAP_PIXEL_TOL = 0.5;
+
+// packed coordinates are fixed point degrees, about a metre
+const int VMAP_UNITS = 100000;
+
+// one level of detail of a layer; polylines as packed lat/lon pairs with a bounding
+// box each, so whole lines off the screen are skipped without touching their points
+struct VideoMapLod {
+    vector<int32_t> coords; // lat, lon
+    vector<uint32_t> counts; // points per polyline
+    vector<int32_t> boxes; // min lat, min lon, max lat, max lon per polyline
+};
+
+// the sector file layers simplified for every level, built once per sector file
+struct VideoMapData {
+    VideoMapLod lods[VMAP_LAYERS][VMAP_LODS];
+
+    void Build(const SectorGeometry& geo);
+
+    // coarsest level that is still within VMAP_PIXEL_TOL at this zoom
+    static int Lod(double pixPerNM)
+    {
+        int lod = 0;
+        while (lod + 1 < VMAP_LODS && VMAP_LOD_TOL_NM[lod + 1] * pixPerNM <= VMAP_PIXEL_TOL) {
+            lod++;
+        }
+        return lod;
+    };
+};
+
+// screen geometry of the enabled layers for one viewport, drawn from here every
+// time ES repaints the back bitmap
+struct VideoMapCache {
+    bool valid = false;
+    CPosition ll;
+    CPosition ur;
+    RECT area = { 0, 0, 0, 0 };
+    int layers = 0;
+    const VideoMapData* source = nullptr;
+
+    vector<POINT> pts[VMAP_LAYERS];
+    vector<DWORD> counts[VMAP_LAYERS];
+};
+
+class VideoMap :
+    public CRadarScreen
+{
+public:
+    VideoMap(void);
+    ~VideoMap(void);
+
+    static bool CacheStale(CRadarScreen* radscr, const VideoMapCache& cache, const VideoMapData* data, int layers);
+    static void BuildCache(CRadarScreen* radscr, const VideoMapData& data, int layers, VideoMapCache& cache);
+
+    static void DrawLayers(HDC hdc, const VideoMapCache& cache)
+    {
+        // boundaries on top
+        static const COLORREF colors[VMAP_LAYERS] = { RGB(110, 110, 110), RGB(70, 70, 70), RGB(85, 85, 85) };
+
+        CDC dc;
+        dc.Attach(hdc);
+
+        for (int l = VMAP_LAYERS - 1; l >= 0; l--) {
+            if (cache.counts[l].empty()) {
+                continue;
+            }
+
+            HPEN targetPen = CreatePen(PS_SOLID, 1, colors[l]);
+            HGDIOBJ oldPen = dc.SelectObject(targetPen);
+
+            dc.PolyPolyline(&cache.pts[l][0], &cache.counts[l][0], (int)cache.counts[l].size());
+
+            dc.SelectObject(oldPen);
+            DeleteObject(targetPen);
+        }
+
+        dc.Detach();
+    };
+};
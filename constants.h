@@ -8,6 +8,10 @@ using namespace EuroScopePlugIn;
 
 // Tag Items
 const int TAG_ITEM_PLANE_HALO = 1;
+const int TAG_ITEM_MTCD_PARTNER = 2;
+const int TAG_ITEM_MTCD_TIME = 3;
+const int TAG_ITEM_CJS = 4;
+const int TAG_ITEM_EQUIPMENT = 5;
 const int AIRCRAFT_SYMBOL = 200;
 const int AIRCRAFT_CJS = 400;
 
@@ -16,6 +20,20 @@ const int BUTTON_MENU_HALO_OPTIONS = 202;
 const int BUTTON_MENU_ALT_FILT_OPT = 203;
 const int BUTTON_MENU_ALT_FILT_ON = 204;
 const int BUTTON_MENU_ALT_FILT_SAVE = 205;
+const int BUTTON_MENU_PTL_OPTIONS = 206;
+const int BUTTON_MENU_RBL = 207;
+const int BUTTON_MENU_RINGS = 208;
+const int BUTTON_MENU_GRID = 209;
+const int BUTTON_MENU_TAGS = 210;
+const int BUTTON_MENU_GND = 211;
+const int BUTTON_MENU_CJS = 212;
+const int BUTTON_MENU_MAP = 213;
+const int BUTTON_MENU_HIST = 214;
+const int BUTTON_MENU_XTRAP = 215;
+const int BUTTON_MENU_STATS = 216;
+const int BUTTON_MENU_CLUSTER = 217;
+const int BUTTON_MENU_DENSITY = 218;
+const int BUTTON_MENU_QUICK_LOOK = 219;
 
 // Menu Modules
 const int MODULE_1_X = 0;
@@ -27,10 +45,22 @@ const int MODULE_2_Y = 2;
 const int FUNCTION_ALT_FILT_LOW = 301;
 const int FUNCTION_ALT_FILT_HIGH = 302;
 const int FUNCTION_ALT_FILT_SAVE = 303;
+const int FUNCTION_CPA_RADIUS = 304;
+const int FUNCTION_GND_AIRPORT = 305;
+const int FUNCTION_CJS_SECTOR = 306;
+const int FUNCTION_CJS_LEAD = 307;
+const int FUNCTION_MAP_LAYER = 308;
+const int FUNCTION_CLUSTER_RANGE = 309;
+const int FUNCTION_ALT_FILT_BANDS = 310;
+const int FUNCTION_ALT_FILT_VFR = 311;
+const int FUNCTION_QUICK_LOOK = 312;
 
 // Radar Background
 const int SCREEN_BACKGROUND = 501;
 
+// Range bearing lines, id is the index in the rbl list
+const int RBL_LINE = 601;
+
 const int ADD_FREE_TEXT = 1101;
 const int DELETE_FREE_TEXT = 1102;
 const int DELETE_ALL_FREE_TEXT = 1103;
@@ -1,2 +1,10 @@
 #include "pch.h"
 #include "tagRender.h"
+
+tagRender::tagRender()
+{
+}
+
+tagRender::~tagRender()
+{
+}
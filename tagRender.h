@@ -1,26 +1,145 @@
 #pragma once
 #include "EuroScopePlugIn.h"
-#include "CSiTRadar.h"
-
+#include "TargetStore.h"
+#include <string>
+#include <map>
 
 using namespace std;
+using namespace EuroScopePlugIn;
+
+const int TAG_MAX_LINES = 3;
+
+// a data block's text and the size of each line, kept between frames so an
+// unchanged tag is drawn without formatting or measuring anything
+struct TagLayout {
+    unsigned int version = 0; // target store version the text was built from
+    bool detailed = false;
+    int lineCount = 0;
+    string lines[TAG_MAX_LINES];
+    CSize sizes[TAG_MAX_LINES];
+    CSize extent; // whole block
+};
+
+typedef map<string, TagLayout, less<>> TagLayoutCache; // looked up by const char* without a string
 
 class tagRender :
     public EuroScopePlugIn::CRadarScreen
 {
 public:
-    RECT drawTag(CDC hc, const char* callSign, POINT p, bool detailed, CRadarTarget rt) {
+    tagRender(void);
+    virtual ~tagRender(void);
+
+    // brings the layout up to date with the target; the font used to draw the tags must
+    // already be selected. Returns true if anything had to be measured
+    static bool UpdateLayout(CDC& dc, TagLayout& layout, const char* callSign, const TargetData& td, bool detailed)
+    {
+        if (layout.version == td.version && layout.detailed == detailed && layout.lineCount > 0) {
+            return false;
+        }
+
+        string lines[TAG_MAX_LINES];
+        int n = 0;
+
+        // altitude in hundreds, and a trend arrow when climbing or descending
+        char alt[16];
+        sprintf_s(alt, "%03d%s", max(td.alt, 0) / 100, td.vs > 300 ? "^" : td.vs < -300 ? "v" : "");
+
+        char gs[8];
+        sprintf_s(gs, "%02d", td.gs / 10);
+
+        if (detailed) {
+            lines[n++] = callSign;
+
+            // cleared level only when it differs from where the aircraft is
+            string l2 = alt;
+            if (td.clearedAlt == 1) { l2 += " ILS"; }
+            else if (td.clearedAlt == 2) { l2 += " VIS"; }
+            else if (td.clearedAlt > 2 && abs(td.clearedAlt - td.alt) >= 100) {
+                char cfl[8];
+                sprintf_s(cfl, " %03d", td.clearedAlt / 100);
+                l2 += cfl;
+            }
+            lines[n++] = l2;
+
+            lines[n++] = string(gs) + " " + td.acType;
+        }
+        else {
+            lines[n++] = alt;
+            lines[n++] = gs;
+        }
 
-        if (detailed == FALSE) {
-            int alt = rt.GetPosition().GetPressureAltitude();
-            int vs = rt.GetVerticalSpeed();
+        // only lines whose text changed get measured again
+        bool measured = false;
+        CSize extent;
+        extent.cx = 0;
+        extent.cy = 0;
+        for (int i = 0; i < n; i++) {
+            if (i >= layout.lineCount || lines[i] != layout.lines[i]) {
+                layout.lines[i] = lines[i];
+                layout.sizes[i] = dc.GetTextExtent(lines[i].c_str(), (int)lines[i].size());
+                measured = true;
+            }
+            extent.cx = max(extent.cx, layout.sizes[i].cx);
+            extent.cy += layout.sizes[i].cy;
         }
+
+        layout.lineCount = n;
+        layout.extent = extent;
+        layout.version = td.version;
+        layout.detailed = detailed;
+
+        return measured;
     };
 
-protected:
-    int leaderLen = 10;
-    int tagAngle = 30; 
+    // end of a leader line from p; the angle is clockwise from north, in degrees
+    static POINT LeaderEnd(POINT p, int leaderLen, int tagAngle)
+    {
+        double a = tagAngle * 3.14159265358979 / 180.0;
 
+        POINT end;
+        end.x = p.x + (int)round(sin(a) * leaderLen);
+        end.y = p.y - (int)round(cos(a) * leaderLen);
+        return end;
+    };
 
-};
+    // where the block goes for a given leader: beside the end of the leader, on the
+    // side it points to, with the first line level with the end
+    static RECT TagRect(const TagLayout& layout, POINT p, int leaderLen, int tagAngle)
+    {
+        POINT end = LeaderEnd(p, leaderLen, tagAngle);
+        int firstLine = layout.lineCount > 0 ? layout.sizes[0].cy : 0;
+
+        RECT r;
+        r.top = end.y - firstLine / 2;
+        r.bottom = r.top + layout.extent.cy;
+        if (end.x >= p.x) {
+            r.left = end.x + 2;
+            r.right = r.left + layout.extent.cx;
+        }
+        else {
+            r.right = end.x - 2;
+            r.left = r.right - layout.extent.cx;
+        }
+        return r;
+    };
+
+    // leader line and text; the pen, font and text colour are the caller's. Returns the tag rectangle
+    static RECT drawTag(CDC& dc, const TagLayout& layout, POINT p, int leaderLen, int tagAngle)
+    {
+        RECT r = TagRect(layout, p, leaderLen, tagAngle);
 
+        // leader starts clear of the PPS symbol
+        POINT start = LeaderEnd(p, min(6, leaderLen), tagAngle);
+        POINT end = LeaderEnd(p, leaderLen, tagAngle);
+        dc.MoveTo(start.x, start.y);
+        dc.LineTo(end.x, end.y);
+
+        int y = r.top;
+        for (int i = 0; i < layout.lineCount; i++) {
+            dc.TextOut(r.left, y, layout.lines[i].c_str(), (int)layout.lines[i].size());
+            y += layout.sizes[i].cy;
+        }
+
+        return r;
+    };
+};